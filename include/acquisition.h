@@ -0,0 +1,49 @@
+#ifndef ACQUISITION_H_
+#define ACQUISITION_H_
+#include <stdint.h>
+
+#include "measurement.h"
+
+#define ACQUISITION_MAX_TASKS 4
+#define ACQUISITION_TIMEOUT_MS 2000
+
+// A sensor that can run its conversion in the background.
+class SensorTask {
+   public:
+    virtual ~SensorTask() {}
+    // Starts a conversion, returns false if the sensor is not available.
+    virtual bool start(void) = 0;
+    // Returns true once the conversion is done and read() can be called.
+    virtual bool poll(void) = 0;
+    // Reads the converted values into m.
+    virtual void read(Measurement& m) = 0;
+};
+
+// Timing of the last run, all values are micros() relative to the start of the run. Overwritten by the next
+// run, Health keeps the per-task maximum and the timeouts for the health record.
+struct AcquisitionTiming {
+    uint32_t started[ACQUISITION_MAX_TASKS];  // start() returned
+    uint32_t done[ACQUISITION_MAX_TASKS];     // read() returned, 0 if the sensor was unavailable or timed out
+    uint32_t total;
+    uint8_t timedOut;  // One bit per task
+};
+
+class Acquisition {
+   public:
+    Acquisition();
+    ~Acquisition();
+    bool add(SensorTask* task, const char* name);
+    // Starts all sensors, then collects each one as it becomes ready.
+    void run(Measurement& m);
+    void printTiming(void);
+
+    AcquisitionTiming timing;
+
+   private:
+    SensorTask* tasks[ACQUISITION_MAX_TASKS];
+    const char* names[ACQUISITION_MAX_TASKS];
+    uint8_t numTasks;
+};
+
+extern Acquisition acquisition;
+#endif
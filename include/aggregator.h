@@ -0,0 +1,43 @@
+#ifndef AGGREGATOR_H_
+#define AGGREGATOR_H_
+#include <stdint.h>
+
+#include "measurement.h"
+
+// Running statistics of the current window, kept in RTC user memory between wakes.
+class AggregateState {
+   public:
+    AggregateState();
+    ~AggregateState();
+
+    uint32_t windowStart;
+    uint16_t samples;
+    uint16_t count[MEASUREMENT_CHANNELS];  // Samples with a value, per channel
+    float min[MEASUREMENT_CHANNELS];
+    float max[MEASUREMENT_CHANNELS];
+    float sum[MEASUREMENT_CHANNELS];
+    uint32_t crc;
+};
+
+// Collects min/max/mean per channel over settings.store.aggregatewindow minutes and appends
+// TYPE_SUMMARY_MIN/MAX/MEAN records to the measurement log when a window is complete. The records count
+// their samples in bits, so a window is limited to SETTINGS_MAX_WINDOW_SAMPLES samples, 255 minutes at
+// the default 60 s interval. Three records per window cut the stored volume by samples per window / 3.
+class Aggregator {
+   public:
+    Aggregator();
+    ~Aggregator();
+    // Loads the running state from RTC memory
+    void begin(void);
+    void add(Measurement& m);
+
+   private:
+    void emit(void);
+    void reset(uint32_t windowStart);
+    void save(void);
+
+    AggregateState state;
+};
+
+extern Aggregator aggregator;
+#endif
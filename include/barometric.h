@@ -2,19 +2,24 @@
 #define BAROMETRIC_H_
 #include <Adafruit_BMP280.h>
 
+#include "acquisition.h"
 #include "measurement.h"
 
-class Barometric {
+class Barometric : public SensorTask {
    public:
     Barometric();
     ~Barometric();
     // Initializes Pressure sensor
     void setup(void);
-    // Takes measurement and updates the storage object m
-    void measure(Measurement& m);
+    // Triggers a single forced mode conversion
+    bool start(void);
+    bool poll(void);
+    // Updates the storage object m with the converted values
+    void read(Measurement& m);
 
    private:
     Adafruit_BMP280 bmp;  // use I2C interface
     boolean haveBmp;
+    uint32_t startedAt;
 };
 #endif
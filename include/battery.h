@@ -0,0 +1,31 @@
+#ifndef BATTERY_H_
+#define BATTERY_H_
+#include "acquisition.h"
+#include "measurement.h"
+
+// ADC reads 0-1V as 0-1023, the battery is connected through a divider.
+#define BATTERY_ADC_FULLSCALE 1024.0
+#define BATTERY_DIVIDER_RATIO 5.7  // (100k + 470k) / 100k
+#define BATTERY_OVERSAMPLE 16
+
+class Battery : public SensorTask {
+   public:
+    Battery();
+    ~Battery();
+    // Reads external power and the config strap in one expander read, the next start() uses it instead of its own.
+    void readInputs(void);
+    // Samples external power state
+    bool start(void);
+    bool poll(void);
+    // Oversamples the battery divider and stores voltage and power state in m
+    void read(Measurement& m);
+
+    bool extPower;
+    bool configStrap;  // IOEXP_CONFIG pulled low
+
+   private:
+    bool inputsRead;
+};
+
+extern Battery battery;
+#endif
@@ -0,0 +1,23 @@
+#ifndef CHANGEFILTER_H_
+#define CHANGEFILTER_H_
+#include <stdint.h>
+
+#include "measurement.h"
+
+// Compares a new sample against the last stored one using the deadband and alarm settings.
+class ChangeFilter {
+   public:
+    enum RESULT : uint8_t { RESULT_SKIP = 0,    // No channel moved beyond its deadband
+                            RESULT_STORE = 1,   // Store the sample
+                            RESULT_ALARM = 2 }; // Store and upload right away
+
+    ChangeFilter();
+    ~ChangeFilter();
+    RESULT check(Measurement& m);
+
+   private:
+    RESULT compare(float current, float last, uint8_t group);
+};
+
+extern ChangeFilter changeFilter;
+#endif
@@ -2,25 +2,52 @@
 #define COMMUNICATION_h
 
 #include <Arduino.h>
+#include <IPAddress.h>
 
-class Communication {
+class WiFiClient;
+
+#include "radio.h"
+
+class Communication : public Radio {
    public:
     Communication();
     ~Communication();
-    void begin(void);
-    time_t getNtpTime();
-    bool registerDevice(void);
+    // Powers the radio up and connects to WiFi, gives up after WIFI_CONNECT_TIMEOUT_MS.
+    bool begin(void) override;
+    // Disconnects and powers the radio down, it stays off until the next begin().
+    void end(void) override;
+    time_t getNtpTime() override;
+    // Datagram uploads on a LAN go without registration.
+    bool registrationNeeded(void) override;
+    // Fails without an upload URL and registration secret.
+    bool registerDevice(void) override;
+    const uint8_t* signingKey(void) override;
+    // UploadTransport, also applies a remote config carried by the reply
+    bool post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) override;
+    // True for a udp:// URL: binary batches as datagrams, no registration, no remote config
+    bool binary(void) override;
+
+    bool configApplied;  // Set when an upload reply carried new settings
 
    private:
-    String jsonQuery(String service, String query);
+    // signature, when given, is sent in the X-Signature header, the reply's ends up in replySignature
+    String jsonQuery(String service, const char* query, size_t queryLen, const char* signature = NULL);
+    bool udpQuery(const char* body, size_t len, const char* signature, UploadReply& reply);
+    // Address of name from dnsCache or a lookup, cached tells which so a failed connect can retry fresh.
+    bool resolve(const char* name, IPAddress& address, bool& cached);
+    bool connectPlain(WiFiClient& client);
     bool begun;
+    bool tokenLoaded;
+    uint8_t deviceToken[64];  // EEPROM_DEVICE_TOKEN_PAGE, the upload signing key
     char ssid[65];
     char psk[65];
     char registrationBase64[89];
+    String replySignature;
     String baseUrl;
     String server;
     uint16_t port;
     bool ssl;
+    bool udp;
 };
 
 extern Communication Comms;
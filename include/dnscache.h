@@ -0,0 +1,50 @@
+#ifndef DNSCACHE_H_
+#define DNSCACHE_H_
+#include <stdint.h>
+
+#define DNS_CACHE_ENTRIES 4
+#define DNS_CACHE_TTL 86400  // Seconds, hostByName does not report the record TTL
+
+struct DnsCacheEntry {
+    uint32_t name;  // CRC32 of the host name, 0 = unused
+    uint32_t address;
+    uint32_t expires;  // Unix time
+};
+
+// Resolved addresses, kept in RTC user memory so they survive deep sleep.
+class DnsCacheBuffer {
+   public:
+    DnsCacheBuffer();
+    ~DnsCacheBuffer();
+
+    DnsCacheEntry entries[DNS_CACHE_ENTRIES];
+    uint32_t crc;
+};
+
+// Lets wakes that use the radio skip DNS lookups for the upload and NTP servers.
+// An entry past its TTL is looked up again, but is still used when that lookup fails.
+// Callers forget an entry when connecting to its address fails, so a server that moved
+// costs one failed attempt.
+class DnsCache {
+   public:
+    DnsCache();
+    ~DnsCache();
+    // Returns true if name is cached, fresh is false once the entry is past its TTL.
+    bool get(const char* name, uint32_t now, uint32_t& address, bool& fresh);
+    // Stores a lookup result, replacing the entry closest to expiry when full.
+    void put(const char* name, uint32_t address, uint32_t now);
+    void forget(const char* name);
+
+    uint32_t hits;  // Lookups saved since boot
+
+   private:
+    void load(void);
+    void save(void);
+    DnsCacheEntry* find(uint32_t name);
+
+    DnsCacheBuffer buffer;
+    bool loaded;
+};
+
+extern DnsCache dnsCache;
+#endif
@@ -13,22 +13,48 @@
 
 #define EEPROM_FIRST_WIFIPAGE           16      // Wifi SSID/PSK first page (2 pages per Pair)
 #define EEPROM_LAST_WIFIPAGE            35      // Last page for Wifi credentials
+#define EEPROM_FIRST_INDEXPAGE          64      // Time index over the measurement log, see logindex.h
+#define EEPROM_LAST_INDEXPAGE          127      // Last page for the time index
+#define EEPROM_MAX_CHIPS                 5      // Chip selects IOEXP_EEPROM0..4
 #define EEPROM_FIRST_SENSORPAGE        128      // First page used for storing measurements not sent to server
 
+#ifndef EEPROM_SPI_DEFAULT_MHZ
+#define EEPROM_SPI_DEFAULT_MHZ 14  // SPI clock when the settings do not name one
+#endif
+#define EEPROM_SPI_SAFE_MHZ 1      // Reference clock for verifying faster ones
+#define EEPROM_SPI_MAX_MHZ 40      // Highest clock accepted by the sk setting
+#define EEPROM_WREN_RETRIES 10     // Attempts to set the write enable latch
+
 class EEPromStore {
    public:
     EEPromStore();
     ~EEPromStore();
     bool readPage(uint8_t* buf, uint32_t pageNo);
+    // Reads count consecutive pages into buf with one sequential read per chip.
+    bool readPages(uint8_t* buf, uint32_t firstPage, uint32_t count);
     bool writePage(uint8_t* buf, uint32_t pageNo);
     void updateMaxPages(uint32_t maxPages);
+    uint32_t getMaxPages(void);
+    // Sets the SPI clock in MHz, 0 for EEPROM_SPI_DEFAULT_MHZ. Each chip is checked the first time it is used
+    // at a new clock: a page read at this clock has to match the same page read at EEPROM_SPI_SAFE_MHZ, else
+    // the clock is halved until it does. A blank page is checked with a test pattern written to it for the check. The results are kept in the RTCC store, so this costs nothing per wake.
+    void setClock(uint8_t mhz);
+    // Clock in MHz used for the chip, verifies it if needed
+    uint8_t getClock(uint8_t chip);
+
+    uint32_t pageWrites;  // Since boot, each costs a write cycle
+    uint32_t writeRetries;  // Since boot, write enable attempts that had to be repeated
 
    private:
     uint8_t getChipPin(uint32_t pageNo);
     uint16_t getPageStart(uint32_t pageNo);
+    uint32_t getClockHz(uint32_t pageNo);
+    uint8_t verifyClock(uint8_t chip);
+    void readRun(uint8_t* buf, uint32_t firstPage, uint32_t count);
+    bool writeRun(uint8_t* buf, uint32_t pageNo);
     void waitForIdle(uint8_t chipPin);
     uint8_t readStatus(uint8_t chipPin);
-    void setWrite(uint8_t chipPin);
+    bool setWrite(uint8_t chipPin);
     void clearWrite(uint8_t chipPin);
 
     uint32_t maxPages;
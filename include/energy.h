@@ -0,0 +1,65 @@
+#ifndef ENERGY_H_
+#define ENERGY_H_
+#include <stdint.h>
+
+// Current draw per state in mA, override with build flags to match a board.
+#ifndef ENERGY_CPU_MA
+#define ENERGY_CPU_MA 20.0  // ESP8266 awake with the radio off
+#endif
+#ifndef ENERGY_RADIO_MA
+#define ENERGY_RADIO_MA 70.0  // Radio on, TX and RX bursts averaged
+#endif
+#ifndef ENERGY_EEPROM_MA
+#define ENERGY_EEPROM_MA 5.0  // 25xx during a write cycle
+#endif
+#ifndef ENERGY_SENSOR_MA
+#define ENERGY_SENSOR_MA 1.5  // One sensor converting, DS18B20
+#endif
+#ifndef ENERGY_SLEEP_MA
+#define ENERGY_SLEEP_MA 0.08  // Deep sleep, ESP8266 with RTCC, expander and regulator
+#endif
+#ifndef ENERGY_BATTERY_MAH
+#define ENERGY_BATTERY_MAH 2600.0
+#endif
+
+#define ENERGY_EEPROM_WRITE_US 5000  // 25xx write cycle time, tWC
+
+enum ENERGY_STATE : uint8_t { ENERGY_CPU = 0,
+                              ENERGY_RADIO = 1,
+                              ENERGY_EEPROM = 2,
+                              ENERGY_SENSOR = 3,
+                              ENERGY_SLEEP = 4,
+                              ENERGY_STATES = 5 };
+
+// Charge used, from the time spent in each state multiplied by its current draw.
+// CPU covers all awake time; radio, EEPROM write cycles and sensor conversions draw on top of it.
+// Sensor time is summed per sensor, two sensors converting for 1 s count as 2 s.
+class EnergyModel {
+   public:
+    EnergyModel();
+    ~EnergyModel();
+    void reset(void);
+    void setCurrent(ENERGY_STATE state, float mA);
+    float current(ENERGY_STATE state);
+    void add(ENERGY_STATE state, uint64_t us);
+    // Adds one wake: awake time, the sensor conversions of the last acquisition run,
+    // EEPROM page writes since the previous call and the radio time spent.
+    void addWake(uint64_t awakeUs, uint32_t radioMs);
+    static const char* name(ENERGY_STATE state);
+
+    float mAh(ENERGY_STATE state);
+    float mAhTotal(void);
+    // Total scaled to a day, assuming the time added so far is typical
+    float mAhPerDay(void);
+    // Days on a battery of the given capacity at that rate
+    float batteryDays(float capacitymAh);
+
+    uint64_t us[ENERGY_STATES];
+
+   private:
+    float currentmA[ENERGY_STATES];
+    uint32_t lastPageWrites;
+};
+
+extern EnergyModel energy;
+#endif
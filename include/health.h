@@ -0,0 +1,41 @@
+#ifndef HEALTH_H_
+#define HEALTH_H_
+#include <stdint.h>
+#include <time.h>
+
+#include "acquisition.h"
+#include "measurement.h"
+
+// Device health telemetry: every settings.store.healthinterval minutes a TYPE_HEALTH record with heap, radio,
+// EEPROM and wake counters goes into the measurement log, so it is uploaded and exported like the samples.
+// Connection figures are those of the last upload, the radio is off when the record is made. Sensor
+// timeouts and conversion times cover every wake since the previous record.
+class Health {
+   public:
+    Health();
+    ~Health();
+    // True when the health interval has passed since the last health record.
+    bool due(time_t now);
+    // Appends a health record with the timestamp, battery voltage and power bits of sample.
+    bool record(const Measurement& sample);
+    // Called by Communication once WiFi is up, rssi in dBm.
+    void connected(uint32_t connectMs, int32_t rssi, uint8_t channel);
+    // Called by Communication after each TLS handshake.
+    void tlsDone(uint32_t handshakeMs);
+    // Awake time of the wake that just ended, reported by the next record.
+    void wakeDone(uint32_t wakeMs);
+    // Folds the timing of an acquisition run into the next record.
+    void sensorsDone(const AcquisitionTiming& timing);
+
+   private:
+    uint32_t connectMs;
+    int32_t rssi;
+    uint8_t channel;
+    uint32_t tlsMs;
+    uint32_t lastWakeMs;
+    uint32_t sensorTimeouts;
+    uint8_t sensorMs[ACQUISITION_MAX_TASKS];  // 8 ms units
+};
+
+extern Health health;
+#endif
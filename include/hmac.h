@@ -0,0 +1,41 @@
+#ifndef HMAC_H_
+#define HMAC_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+// SHA-256 (FIPS 180-4), fed incrementally.
+class Sha256 {
+   public:
+    Sha256();
+    ~Sha256();
+    void begin(void);
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t* digest);
+
+   private:
+    void transform(const uint8_t* block);
+
+    uint32_t state[8];
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    uint64_t length;  // Bytes hashed so far
+    size_t used;      // Bytes in buffer
+};
+
+// HMAC-SHA256 (RFC 2104), fed incrementally so a message never has to be held in memory.
+class HmacSha256 {
+   public:
+    HmacSha256();
+    ~HmacSha256();
+    void begin(const uint8_t* key, size_t keyLen);
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t* mac);
+
+   private:
+    Sha256 inner;
+    uint8_t pad[SHA256_BLOCK_SIZE];  // Key xor opad, kept for finish
+};
+
+#endif
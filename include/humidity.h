@@ -0,0 +1,22 @@
+#ifndef HUMIDITY_H_
+#define HUMIDITY_H_
+#include <DHT.h>
+
+#include "acquisition.h"
+#include "measurement.h"
+
+class Humidity : public SensorTask {
+   public:
+    Humidity();
+    ~Humidity();
+    void setup(void);
+    // The DHT22 has no separate conversion step, the transfer happens in read()
+    bool start(void);
+    bool poll(void);
+    void read(Measurement& m);
+
+   private:
+    DHT dht;
+    bool haveDht;
+};
+#endif
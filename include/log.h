@@ -0,0 +1,64 @@
+#ifndef LOG_H_
+#define LOG_H_
+#include <Arduino.h>
+
+#define LOG_BUFFER_SIZE 512
+
+enum LOG_LEVEL : uint8_t { LOG_ERROR = 1,
+                           LOG_INFO = 2,
+                           LOG_DEBUG = 3 };
+
+// Highest level compiled in, everything above it costs nothing.
+#ifndef LOG_LEVEL_MAX
+#ifdef RELEASE
+#define LOG_LEVEL_MAX LOG_ERROR
+#else
+#define LOG_LEVEL_MAX LOG_DEBUG
+#endif
+#endif
+
+// Buffers log output in RAM and only hands Serial what fits in its FIFO, so logging never blocks.
+// Output that doesn't fit in the buffer is dropped and counted.
+class LogSink : public Print {
+   public:
+    LogSink();
+    ~LogSink();
+    size_t write(uint8_t c) override;
+    using Print::write;
+    // Moves buffered output to Serial without blocking, call from idle points.
+    void pump(void);
+    // Blocks until everything is written, call before sleeping.
+    void drain(void);
+
+    uint32_t dropped;
+
+   private:
+    char buffer[LOG_BUFFER_SIZE];
+    uint16_t head;
+    uint16_t tail;
+};
+
+extern LogSink logSink;
+
+template <LOG_LEVEL level>
+class Log {
+   public:
+    static constexpr bool enabled = level <= LOG_LEVEL_MAX;
+
+    // Above LOG_LEVEL_MAX the body is discarded, nothing of the call is left but argument expressions
+    // with side effects. Arguments go by reference so a String is not copied just to be logged.
+    template <typename... Args>
+    static inline void print(const Args&... args) {
+        if constexpr (enabled) logSink.print(args...);
+    }
+    template <typename... Args>
+    static inline void println(const Args&... args) {
+        if constexpr (enabled) logSink.println(args...);
+    }
+};
+
+typedef Log<LOG_ERROR> LogError;
+typedef Log<LOG_INFO> LogInfo;
+typedef Log<LOG_DEBUG> LogDebug;
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef LOGEXPORT_H_
+#define LOGEXPORT_H_
+#include <stdint.h>
+
+#define EXPORT_CONSOLE_BAUD 115200  // Must match Serial.begin in setup()
+#define EXPORT_BAUD 921600
+#define EXPORT_SWITCH_MS 200  // Pause around baud changes so the host can follow
+#define EXPORT_CHUNK_PAGES 8  // Pages read from EEPROM in one go
+
+#define EXPORT_MAGIC0 0xa5
+#define EXPORT_MAGIC1 0x5a
+#define EXPORT_END_PAGE 0xffffffff  // Last frame, its data starts with the number of pages sent
+
+// One exported page, little endian. crc is CRC32 over page and data.
+struct ExportFrame {
+    uint8_t magic[2];
+    uint8_t page[4];
+    uint8_t data[64];
+    uint8_t crc[4];
+};
+
+/* Binary export of EEPROM pages over Serial
+   The device prints "EXPORT <first> <count> <baud>", switches to <baud>, sends one ExportFrame per page
+   and an end frame, then returns to EXPORT_CONSOLE_BAUD. tools/exportlog.py decodes the stream to CSV.
+*/
+class LogExport {
+   public:
+    LogExport();
+    ~LogExport();
+    bool run(uint32_t firstPage, uint32_t count);
+
+   private:
+    void sendFrame(uint32_t page, uint8_t* data);
+};
+
+extern LogExport logExport;
+#endif
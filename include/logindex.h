@@ -0,0 +1,53 @@
+#ifndef LOGINDEX_H_
+#define LOGINDEX_H_
+#include <stdint.h>
+
+#include "eepromstore.h"
+
+#define LOGINDEX_STRIDE 16            // Records per index entry
+#define LOGINDEX_ENTRIES_PER_PAGE 7   // Entries in one LogIndexPage
+#define LOGINDEX_EMPTY 0xffffffff     // seq of an entry without a record
+
+// First sequence number and timestamp of the records in one block of LOGINDEX_STRIDE ring pages.
+struct LogIndexEntry {
+    uint32_t seq;
+    uint32_t timestamp;
+};
+
+// One EEPROM page of the index, entry n of page p describes block p * LOGINDEX_ENTRIES_PER_PAGE + n.
+struct LogIndexPage {
+    LogIndexEntry entries[LOGINDEX_ENTRIES_PER_PAGE];
+    uint32_t reserved;
+    uint32_t crc;
+};
+
+/* Sparse time index over the measurement log
+   The ring of MeasurementLog is cut into blocks of LOGINDEX_STRIDE pages. The index holds the sequence number
+   and timestamp of the record at the start of each block, in the pages from EEPROM_FIRST_INDEXPAGE.
+   append() updates it when a record starts a block, so it costs one extra page write per LOGINDEX_STRIDE records.
+   The sequence number a block start must hold follows from nextId and the capacity, so an entry that does not
+   match it is stale: after a failed update, a power loss between the two writes or a change of the chip count.
+   Stale entries and pages failing their CRC are rebuilt from the records when a lookup reaches them.
+*/
+class LogIndex {
+   public:
+    LogIndex();
+    ~LogIndex();
+    // Records that seq, stored with timestamp, starts its block. No-op for other records.
+    void update(uint32_t seq, uint32_t timestamp);
+    // Sequence number of the first record with a timestamp at or after timestamp, nextId if there is none.
+    // Assumes timestamps rise with the sequence number, as they do unless the clock is set back.
+    uint32_t find(uint32_t timestamp);
+    // Number of records read by the last find, for comparing with a full scan
+    uint32_t lastReads;
+
+   private:
+    uint32_t blocks(void);
+    uint32_t blockStart(uint32_t block);
+    bool rebuild(LogIndexPage& page, uint32_t pageNo);
+    bool loadPage(LogIndexPage& page, uint32_t pageNo);
+    void savePage(LogIndexPage& page, uint32_t pageNo);
+};
+
+extern LogIndex logIndex;
+#endif
@@ -3,6 +3,17 @@
 
 #include <stdint.h>
 
+#define MEASUREMENT_BIT_EXTPOWER 0x01
+#define MEASUREMENT_CHANNELS 13
+#define MEASUREMENT_HEALTH_FIELDS 12
+
+// Channel groups, used for deadband and alarm thresholds
+#define CHANNEL_TEMPERATURE 0
+#define CHANNEL_HUMIDITY 1
+#define CHANNEL_PRESSURE 2
+#define CHANNEL_BATTERY 3
+#define CHANNEL_GROUPS 4
+
 class Measurement {
    public:
     static float NaN();
@@ -13,8 +24,30 @@ class Measurement {
     void genCrc();
     bool checkCrc();
 
+    // All float channels of a sensor read, batteryvoltage..tempsens7. The constructor, the serializers, the
+    // aggregator and the change filter loop over this table; a new channel needs its field and one line here.
+    struct Channel {
+        float Measurement::*field;
+        uint8_t group;
+        const char* key;  // Name in uploads, dumps and tools/exportlog.py
+    };
+    static const Channel channels[MEASUREMENT_CHANNELS];
+
+    // Counters of a health record, freeheap..resetreason, in the order uploads and dumps list them.
+    struct HealthField {
+        uint32_t Measurement::*field;
+        bool isSigned;
+        const char* key;
+    };
+    static const HealthField healthFields[MEASUREMENT_HEALTH_FIELDS];
+
+    // Summary records use the sensor read layout with bits holding the number of samples in the window.
     enum TYPE : uint8_t { TYPE_SENSORREAD = 0x01,
-                          TYPE_PWRFAIL = 0x20,
+                          TYPE_SUMMARY_MIN = 0x02,
+                          TYPE_SUMMARY_MAX = 0x03,
+                          TYPE_SUMMARY_MEAN = 0x04,
+                          TYPE_PWRFAIL = 0x20,  // Only timestamp, powerfail and powerback are used
+                          TYPE_HEALTH = 0x21,   // batteryvoltage and the health fields, see Health
                           TYPE_UNKNOWN = 0xff };
 
     // Total size should be 64bytes
@@ -29,20 +62,87 @@ class Measurement {
     union {
         float baropress;
         uint32_t powerback;
+        uint32_t freeheap;  // Bytes
+    };
+    union {
+        float barotemp;
+        uint32_t maxfreeblock;  // Bytes, largest allocation possible
+    };
+    union {
+        float humidity;
+        uint32_t rssi;  // dBm, negative
+    };
+    union {
+        float humidtemp;
+        uint32_t wifichannel;
+    };
+    union {
+        float tempsens0;
+        uint32_t connectms;  // WiFi association of the last connection
+    };
+    union {
+        float tempsens1;
+        uint32_t tlsms;  // TLS handshake of the last HTTPS request
+    };
+    union {
+        float tempsens2;
+        uint32_t eepromwrites;  // Page writes since boot
+    };
+    union {
+        float tempsens3;
+        uint32_t eepromretries;  // Write enable retries since boot
+    };
+    union {
+        float tempsens4;
+        uint32_t wakems;  // Awake time of the previous wake
+    };
+    union {
+        float tempsens5;
+        uint32_t resetreason;  // rst_info reason of the last boot
+    };
+    union {
+        float tempsens6;
+        uint32_t sensortimeouts;  // Acquisition tasks that timed out since the previous record, one bit each
+    };
+    union {
+        float tempsens7;
+        uint32_t sensorms;  // Longest conversion per task since the previous record, a byte each in 8 ms units
     };
-    float barotemp;
-    float humidity;
-    float humidtemp;
-    float tempsens0;
-    float tempsens1;
-    float tempsens2;
-    float tempsens3;
-    float tempsens4;
-    float tempsens5;
-    float tempsens6;
-    float tempsens7;
    private:
     uint32_t crc;
 };
 
+// Defined here rather than in measurement.cpp so the compiler sees the table where it is looped over,
+// and can unroll those loops with the fields resolved to fixed offsets.
+inline constexpr Measurement::Channel Measurement::channels[MEASUREMENT_CHANNELS] = {
+    {&Measurement::batteryvoltage, CHANNEL_BATTERY, "bat"},
+    {&Measurement::baropress, CHANNEL_PRESSURE, "press"},
+    {&Measurement::barotemp, CHANNEL_TEMPERATURE, "btemp"},
+    {&Measurement::humidity, CHANNEL_HUMIDITY, "hum"},
+    {&Measurement::humidtemp, CHANNEL_TEMPERATURE, "htemp"},
+    {&Measurement::tempsens0, CHANNEL_TEMPERATURE, "t0"},
+    {&Measurement::tempsens1, CHANNEL_TEMPERATURE, "t1"},
+    {&Measurement::tempsens2, CHANNEL_TEMPERATURE, "t2"},
+    {&Measurement::tempsens3, CHANNEL_TEMPERATURE, "t3"},
+    {&Measurement::tempsens4, CHANNEL_TEMPERATURE, "t4"},
+    {&Measurement::tempsens5, CHANNEL_TEMPERATURE, "t5"},
+    {&Measurement::tempsens6, CHANNEL_TEMPERATURE, "t6"},
+    {&Measurement::tempsens7, CHANNEL_TEMPERATURE, "t7"},
+};
+
+inline constexpr Measurement::HealthField Measurement::healthFields[MEASUREMENT_HEALTH_FIELDS] = {
+    {&Measurement::freeheap, false, "heap"},
+    {&Measurement::maxfreeblock, false, "maxblock"},
+    {&Measurement::rssi, true, "rssi"},
+    {&Measurement::wifichannel, false, "chan"},
+    {&Measurement::connectms, false, "connms"},
+    {&Measurement::tlsms, false, "tlsms"},
+    {&Measurement::eepromwrites, false, "eewrites"},
+    {&Measurement::eepromretries, false, "eeretries"},
+    {&Measurement::wakems, false, "wakems"},
+    {&Measurement::resetreason, false, "reset"},
+    {&Measurement::sensortimeouts, false, "sensto"},
+    {&Measurement::sensorms, false, "sensms"},
+};
+
 #endif
@@ -0,0 +1,32 @@
+#ifndef MEASUREMENTLOG_H_
+#define MEASUREMENTLOG_H_
+#include <stdint.h>
+
+#include "measurement.h"
+
+// Ring buffer of measurements in the EEPROM pages from EEPROM_FIRST_SENSORPAGE and up.
+// Records are addressed by a sequence number (Clock.store.nextId), Measurement::id holds its low 16 bits.
+// Appends keep logIndex up to date, use logIndex.find to look records up by time.
+class MeasurementLog {
+   public:
+    MeasurementLog();
+    ~MeasurementLog();
+    // Assigns the next id to m, stores it and advances nextId.
+    bool append(Measurement& m);
+    // Appends a TYPE_PWRFAIL record for a power failure the RTCC noted, stamped now.
+    bool appendPowerFail(uint32_t now, uint32_t powerfail, uint32_t powerback);
+    // Reads the record with sequence number seq, fails if it has been overwritten or is corrupt.
+    bool read(Measurement& m, uint32_t seq);
+    // Number of records stored but not yet sent to the server.
+    uint32_t pending(void);
+    // Applies a server acknowledgement, ack is the highest sequence number the server has stored durably.
+    // Sending resumes right after it, or at the oldest record still in the log. Fails for acks beyond nextId.
+    bool acknowledge(uint32_t ack);
+    uint32_t capacity(void);
+
+   private:
+    uint32_t getPage(uint32_t seq);
+};
+
+extern MeasurementLog measurementLog;
+#endif
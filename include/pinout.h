@@ -10,9 +10,14 @@
 #define GPIO_SPIMISO  12 // SPI MISO
 
 #define IOEXP_EXTPOWR 0
+#define IOEXP_CONFIG  1 // Strap/button to GND, opens the serial configuration window on boot
 #define IOEXP_EEPROM0 8
 #define IOEXP_EEPROM1 9
 #define IOEXP_EEPROM2 10
 #define IOEXP_EEPROM3 11
 #define IOEXP_EEPROM4 12
+
+// RTCC MFP is the alarm output, active low and AC coupled to RST next to GPIO16, so an alarm wakes the
+// ESP8266 from deep sleep like its own timer does.
+#define RTCC_MFP_WAKE 1
 #endif
@@ -0,0 +1,26 @@
+#ifndef RADIO_H_
+#define RADIO_H_
+#include <stdint.h>
+#include <time.h>
+
+#include "uploader.h"
+
+// The network side of a wake: join, register, upload and get the time. The device does this over WiFi
+// (Communication), the host runners simulate it, so WakeCycle runs the same code on all of them.
+class Radio : public UploadTransport {
+   public:
+    virtual ~Radio() {}
+    // Powers the radio up and joins the network.
+    virtual bool begin(void) = 0;
+    // Powers the radio down, it stays off until the next begin().
+    virtual void end(void) = 0;
+    // True if uploads have to wait for registerDevice() while settings.registered is not set.
+    virtual bool registrationNeeded(void) = 0;
+    // Registers with the server and stores the device token, sets settings.registered.
+    virtual bool registerDevice(void) = 0;
+    // Device token to sign uploads with, EEPROM_PAGESIZE bytes, NULL for unsigned uploads.
+    virtual const uint8_t* signingKey(void) = 0;
+    // Unix time from the network, 0 if there is none.
+    virtual time_t getNtpTime(void) = 0;
+};
+#endif
@@ -15,9 +15,22 @@ class RTCCmem {
     uint32_t nextId;
     uint32_t lastSentId;
     uint32_t lastUsedWifi;
-    time_t lastNTPcheck;
-    time_t nextNTPcheck;
-    uint32_t reserved[10];
+    // Unix times, fixed width so the layout is the same in host builds
+    uint32_t lastNTPcheck;
+    uint32_t nextNTPcheck;
+    uint32_t lastUpload;
+    uint32_t skippedSamples;  // Samples not stored because nothing changed
+    // Upload retry policy, see UploadPolicy
+    uint32_t uploadFailures;     // Consecutive failed upload attempts
+    uint32_t nextUploadAttempt;  // No attempt before this time while failing
+    uint32_t radioDay;           // Day (unix time / 86400) radioMsToday belongs to
+    uint32_t radioMsToday;       // Radio on time spent this day
+    // EEPROM SPI clock, see EEPromStore::setClock
+    uint8_t eepromMHz[5];          // Verified clock per chip (EEPROM_MAX_CHIPS), 0 = not verified yet
+    uint8_t eepromMHzRequested;    // Clock the chips were verified for, 0 = EEPROM_SPI_DEFAULT_MHZ
+    uint8_t reserved8[2];
+    uint32_t radioFreeWakes;  // Wakes that sampled without powering the radio, see UploadPolicy::wakeDone
+    uint32_t lastHealth;      // Unix time of the last health record, see Health
     uint32_t crc;
 };
 
@@ -30,6 +43,11 @@ class RTCC {
     time_t getTime(void);
     bool loadStore(void);
     void saveStore(void);
+    // Programs alarm 0 to match the full date and time t. Its MFP output drives RTCC_MFP_WAKE.
+    void setAlarm(time_t t);
+    // True once alarm 0 has matched, until setAlarm or clearAlarm.
+    bool alarmFired(void);
+    void clearAlarm(void);
 
     bool running;
     time_t powerfail;
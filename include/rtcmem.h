@@ -0,0 +1,13 @@
+#ifndef RTCMEM_H_
+#define RTCMEM_H_
+
+// Layout of the ESP8266 RTC user memory, 128 blocks of 4 bytes.
+// Survives deep sleep but not power loss, every user keeps its own CRC.
+#define RTCMEM_BLOCKS 128
+#define RTCMEM_BLOCKSIZE 4
+
+#define RTCMEM_AGGREGATE_BLOCK 0  // AggregateState, 48 blocks
+#define RTCMEM_TRACE_BLOCK 48     // TraceBuffer, 50 blocks
+#define RTCMEM_DNS_BLOCK 98       // DnsCacheBuffer, 13 blocks
+
+#endif
@@ -1,8 +1,24 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "measurement.h"
+
+#define SETTINGS_DEFAULT_SAMPLEINTERVAL 60
+#define SETTINGS_DEFAULT_UPLOADINTERVAL 60
+#define SETTINGS_DEFAULT_BATCHSIZE 60
+#define SETTINGS_DEFAULT_MAXSTOREINTERVAL 60
+#define SETTINGS_DEFAULT_AGGREGATEWINDOW 0  // Disabled
+#define SETTINGS_DEFAULT_RADIOBUDGET 600    // Seconds per day
+#define SETTINGS_DEFAULT_TEMPRESOLUTION 12  // Bits
+#define SETTINGS_DEFAULT_HEALTHINTERVAL 1440  // Minutes, one health record a day
+#define SETTINGS_MAX_WINDOW_SAMPLES 255  // Summary records count their samples in the 8 bit Measurement::bits
+
+#define AGGREGATE_WITH_RAW 0  // Summaries are stored alongside raw samples
+#define AGGREGATE_ONLY 1      // Only summaries are stored
+
 class SettingsStorage {
    public:
     SettingsStorage();
@@ -12,6 +28,8 @@ class SettingsStorage {
     bool checkCrc(void);
     bool setFromBuf(uint8_t* buf);
     void copyToBuf(uint8_t* buf);
+    // True if a summary window holds at most SETTINGS_MAX_WINDOW_SAMPLES samples at the sample interval.
+    bool windowFits(void);
 
     // Total size should be 64bytes
     uint8_t bmpavail;
@@ -19,9 +37,22 @@ class SettingsStorage {
     uint8_t numeeprom;
     uint8_t numtempsens;
     uint8_t numwificreds;
-    uint8_t reserved8[3];
+    uint8_t aggregatemode;  // AGGREGATE_WITH_RAW or AGGREGATE_ONLY
+    uint8_t tempresolution;  // DS18B20 resolution in bits, 9-12
+    uint8_t spiclock;        // EEPROM SPI clock in MHz, 0 = EEPROM_SPI_DEFAULT_MHZ
     uint32_t serialno;
-    uint32_t reserved32[12];
+    uint16_t sampleinterval;  // Seconds between samples
+    uint16_t uploadinterval;  // Minutes between uploads when on battery
+    uint16_t batchsize;       // Samples collected before uploading when on battery
+    uint16_t maxstoreinterval;            // Minutes, a sample is stored at least this often
+    uint16_t deadband[CHANNEL_GROUPS];  // Hundredths, smaller changes are not stored. 0 = store every sample
+    uint16_t alarm[CHANNEL_GROUPS];     // Hundredths, larger changes trigger an upload. 0 = disabled
+    uint16_t aggregatewindow;  // Minutes per summary window, 0 = no summaries, see windowFits
+    uint16_t radiobudget;      // Seconds of radio time per day when on battery
+    uint32_t configversion;  // Version of the last remote config applied, 0 = none
+    uint16_t healthinterval;  // Minutes between health records, 0 = SETTINGS_DEFAULT_HEALTHINTERVAL
+    uint16_t reserved16;
+    uint32_t reserved32[3];
     uint32_t crc;
 };
 
@@ -29,12 +60,18 @@ class Settings {
    public:
     Settings();
     ~Settings();
-    bool configure(void);
+    // Prints all settings to Serial.
+    void list(void);
+    // Applies one "s..." command line, returns true if the stored settings changed.
+    bool set(char* line, size_t lineLen);
+    // Writes the settings to EEPROM.
+    void save(void);
     bool setFromBuf(uint8_t* buf);
     void copyToBuf(uint8_t* buf);
 
     SettingsStorage store;
     bool urlSet;
+    bool datagramUrl;  // udp:// URL, uploads go to a LAN collector without registration
     bool registrationTokenSet;
     bool registered;
 
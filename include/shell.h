@@ -0,0 +1,54 @@
+#ifndef SHELL_H_
+#define SHELL_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHELL_LINE_LENGTH 128
+#define SHELL_IDLE_TIMEOUT_MS 120000  // A session without input for this long is closed
+#define SHELL_POLL_MS 10              // Poll interval while a session is open
+#define SHELL_DEFAULT_DUMP 10         // Records shown by 'd' without a count
+
+// Line buffered command shell on Serial. poll() never blocks, so sampling goes on while a technician is connected.
+class Shell {
+   public:
+    Shell();
+    ~Shell();
+    // Starts a session, it ends on 'w' or after SHELL_IDLE_TIMEOUT_MS without input.
+    void open(void);
+    // Handles the input that has arrived so far, returns false once the session has ended.
+    bool poll(void);
+    bool active(void);
+
+   private:
+    struct Command {
+        char key;
+        void (Shell::*handler)(void);
+        const char* help;
+    };
+    static const Command commands[];
+
+    void execute(void);
+    void close(void);
+    void help(void);
+    void list(void);
+    void set(void);
+    void write(void);
+    void dumpLog(void);
+    void findLog(void);
+    void dumpRecords(uint32_t first, uint32_t last);
+    void exportPages(void);
+    void stats(void);
+#ifndef RELEASE
+    void dumpTrace(void);
+#endif
+    void energyReport(void);
+
+    char line[SHELL_LINE_LENGTH + 1];
+    size_t lineLen;
+    bool isOpen;
+    bool settingsChanged;
+    uint32_t lastInput;
+};
+
+extern Shell shell;
+#endif
@@ -0,0 +1,31 @@
+#ifndef TEMPSENSORS_H_
+#define TEMPSENSORS_H_
+#include <OneWire.h>
+
+#include "acquisition.h"
+#include "measurement.h"
+
+#define TEMPSENS_MAX 8
+#define TEMPSENS_CONVERSION_MS 750  // 12 bit resolution, halves with every bit less
+
+class TempSensors : public SensorTask {
+   public:
+    TempSensors(OneWire& bus);
+    ~TempSensors();
+    // Loads the sensor addresses from EEPROM_TEMPSENS_PAGE and sets the resolution (9-12 bits) on all sensors
+    void setup(uint8_t numSensors, uint8_t resolution);
+    // Starts conversion on all sensors on the bus at once
+    bool start(void);
+    bool poll(void);
+    void read(Measurement& m);
+
+   private:
+    float readSensor(uint8_t* addr);
+
+    OneWire& oneWire;
+    uint8_t addrs[TEMPSENS_MAX][8];
+    uint8_t numSensors;
+    uint32_t conversionMs;
+    uint32_t startedAt;
+};
+#endif
@@ -0,0 +1,73 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+#include <stdint.h>
+
+#define TRACE_ENTRIES 24
+
+enum TRACE_PHASE : uint8_t { TRACE_RTCC = 0,
+                             TRACE_SETTINGS = 1,
+                             TRACE_SENSORS = 2,
+                             TRACE_APPEND = 3,
+                             TRACE_WIFI = 4,
+                             TRACE_TLS = 5,
+                             TRACE_UPLOAD = 6,
+                             TRACE_BOOT = 7,  // Reset to first sample
+                             TRACE_PHASES = 8 };
+
+#define TRACE_FLAG_END 0x01
+
+struct TraceEntry {
+    uint32_t micros;
+    uint16_t wake;  // Boot counter, micros restarts on every wake
+    TRACE_PHASE phase;
+    uint8_t flags;
+};
+
+// Ring buffer of phase markers, kept in RTC user memory so it survives deep sleep.
+class TraceBuffer {
+   public:
+    TraceBuffer();
+    ~TraceBuffer();
+
+    uint8_t head;  // Next entry to write
+    uint8_t used;
+    uint16_t wake;
+    TraceEntry entries[TRACE_ENTRIES];
+    uint32_t crc;
+};
+
+class Trace {
+   public:
+    Trace();
+    ~Trace();
+    // Loads the buffer from RTC memory and starts a new wake
+    void begin(void);
+    void mark(TRACE_PHASE phase, uint8_t flags);
+    // Stores the buffer in RTC memory, call before sleeping
+    void save(void);
+    void clear(void);
+    void dump(void);
+    uint8_t count(void);
+    // Entry n, oldest first
+    TraceEntry& entry(uint8_t n);
+
+   private:
+    TraceBuffer buffer;
+};
+
+extern Trace trace;
+
+// Tracing compiles to nothing in release builds.
+#ifdef RELEASE
+#define TRACE_WAKE()
+#define TRACE_SAVE()
+#define TRACE_BEGIN(phase)
+#define TRACE_END(phase)
+#else
+#define TRACE_WAKE() trace.begin()
+#define TRACE_SAVE() trace.save()
+#define TRACE_BEGIN(phase) trace.mark(phase, 0)
+#define TRACE_END(phase) trace.mark(phase, TRACE_FLAG_END)
+#endif
+
+#endif
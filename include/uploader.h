@@ -0,0 +1,82 @@
+#ifndef UPLOADER_H_
+#define UPLOADER_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#define UPLOAD_RECORDS_PER_REQUEST 16
+#define UPLOAD_BODY_SIZE 4096  // Request body buffer, allocated while uploading
+#define UPLOAD_RECORD_MAX 320  // Longest JSON text of one record
+#define UPLOAD_TAIL_MAX 64     // Longest JSON text after the last record
+
+// Binary batch format for datagram transports, little endian: an UploadBatchHeader, the records as stored
+// (64 bytes each with their own CRC) and for signed batches the raw HMAC-SHA256 of everything before it.
+// The collector answers with an UploadAck, carrying a truncated HMAC if the batch was signed.
+#define UPLOAD_BATCH_MAGIC 0x5354  // "TS"
+#define UPLOAD_ACK_MAGIC 0x4154    // "TA"
+#define UPLOAD_BATCH_VERSION 1
+#define UPLOAD_FLAG_SIGNED 0x01
+#define UPLOAD_ACK_OK 0
+#define UPLOAD_ACK_FAILED 1  // Not or only partly stored, ack says how far
+#define UPLOAD_ACK_MAC_SIZE 8
+#define UPLOAD_ACK_TIMEOUT_MS 250   // Wait for an ack before sending the batch again
+#define UPLOAD_DATAGRAM_RETRIES 4  // Sends of a batch after the first before giving up
+
+struct UploadBatchHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t serial;
+    uint32_t first;
+    uint32_t last;
+    uint32_t cfgver;
+};
+
+struct UploadAck {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t status;
+    uint32_t serial;
+    uint32_t first;  // Of the batch answered, so a late ack is not taken for the current one
+    uint32_t ack;
+    uint8_t mac[UPLOAD_ACK_MAC_SIZE];  // Over the fields before it
+};
+
+// What a transport extracted from the server's reply to an upload request.
+struct UploadReply {
+    bool ok;      // status was "ok"
+    bool hasAck;  // The reply carried an "ack"
+    uint32_t ack;
+};
+
+// Sends one request and parses the reply. The device does this over WiFi,
+// the fleet simulator over host sockets.
+class UploadTransport {
+   public:
+    virtual ~UploadTransport() {}
+    // True if the transport takes the binary batch format instead of JSON
+    virtual bool binary(void) { return false; }
+    // Returns false if no reply could be parsed. signature is NULL for unsigned requests.
+    virtual bool post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) = 0;
+};
+
+// Sends the measurement log in batches, written straight from EEPROM into the request body and signed on the way.
+// Has no WiFi or JSON library dependencies so the same code runs in the host fleet simulator.
+class Uploader {
+   public:
+    Uploader();
+    ~Uploader();
+    // Sends all records that have not been acknowledged yet. key is the signing key, NULL for unsigned uploads.
+    bool run(UploadTransport& transport, const uint8_t* key, size_t keyLen);
+    // Checks that buf is a valid UploadAck for the binary batch in body and fills reply from it.
+    static bool parseAck(const uint8_t* buf, size_t len, const char* body, const uint8_t* key, size_t keyLen, UploadReply& reply);
+    // Checks replySignature, the X-Signature of the JSON reply to a request signed with signature.
+    static bool checkReply(const char* reply, size_t len, const char* signature, const char* replySignature, const uint8_t* key,
+                           size_t keyLen);
+
+    // Totals since boot
+    uint32_t requests;
+    uint32_t bodyBytes;
+};
+
+extern Uploader uploader;
+#endif
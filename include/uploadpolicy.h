@@ -0,0 +1,41 @@
+#ifndef UPLOADPOLICY_H_
+#define UPLOADPOLICY_H_
+#include <stdint.h>
+#include <time.h>
+
+#define UPLOAD_EXTPOWER_BATCHSIZE 1  // Upload as soon as there is anything to send
+#define UPLOAD_BACKOFF_BASE 60       // Seconds to wait after the first failed attempt
+#define UPLOAD_BACKOFF_MAX 21600     // Longest wait between attempts, seconds
+#define NTP_CHECK_INTERVAL 86400     // Seconds between clock checks, done on upload wakes
+
+// Decides when to spend radio time on uploading.
+// On battery samples are collected into larger batches that are sent less often,
+// on external power they are sent as soon as possible.
+// Failed attempts back off exponentially with jitter, but never past half the time left before unsent records
+// are overwritten, and on battery the radio time per day is capped, so a server outage costs a bounded amount
+// of energy. The state lives in Clock.store to survive deep sleep.
+class UploadPolicy {
+   public:
+    UploadPolicy();
+    ~UploadPolicy();
+    bool uploadDue(time_t now, bool extPower);
+    // False while backing off after failures or when today's radio budget is used up.
+    bool attemptAllowed(time_t now, bool extPower);
+    // Records the outcome of an attempt that kept the radio on for radioMs. A failed attempt that still got
+    // batches acknowledged (progress) backs off from UPLOAD_BACKOFF_BASE again, the server is reachable.
+    void attemptDone(time_t now, bool success, bool progress, uint32_t radioMs);
+    // Counts radio time used for other things, like NTP.
+    void chargeRadio(time_t now, uint32_t radioMs);
+    // Counts the wake as radio-free if radioMs is 0. Saved with the store's next write, there is one every wake.
+    void wakeDone(uint32_t radioMs);
+    // True when the RTCC should be checked against NTP while the radio is up anyway.
+    bool clockCheckDue(time_t now);
+    // Schedules the next clock check NTP_CHECK_INTERVAL from now.
+    void clockChecked(time_t now);
+
+   private:
+    uint32_t backoff(uint32_t failures);
+};
+
+extern UploadPolicy uploadPolicy;
+#endif
@@ -0,0 +1,32 @@
+#ifndef WAKECYCLE_H_
+#define WAKECYCLE_H_
+#include <stdint.h>
+
+#include "changefilter.h"
+#include "measurement.h"
+#include "radio.h"
+
+// One wake of the firmware: sample, summarize, filter and store, health record, then upload if the policy
+// says so. main.cpp, the host simulator and the fleet simulator all run this, only the radio differs,
+// so the host numbers are those of the firmware path.
+class WakeCycle {
+   public:
+    WakeCycle();
+    ~WakeCycle();
+    // Runs one wake and accounts its awake and radio time in the energy model.
+    void run(Radio& radio);
+    // Sets the RTCC from the network time if it is not running or more than an hour off, the radio has to be up.
+    void syncClock(Radio& radio);
+
+    // Of the last run
+    Measurement sample;
+    ChangeFilter::RESULT change;
+    uint32_t radioMs;  // 0 if the radio stayed off
+    uint32_t awakeUs;
+
+   private:
+    uint32_t connectAndUpload(Radio& radio, time_t now);
+};
+
+extern WakeCycle wakeCycle;
+#endif
@@ -0,0 +1,28 @@
+#ifndef WAKESCHEDULE_H_
+#define WAKESCHEDULE_H_
+#include <stdint.h>
+#include <time.h>
+
+#define SCHEDULE_POLL_MS 50         // Alarm flag poll interval in the last second before a slot
+#define SCHEDULE_FALLBACK_MS 2000   // How long past its slot the ESP timer waits for a missing alarm
+
+// Samples are taken at slots aligned to the wall clock: multiples of the sample interval counted from
+// midnight UTC, so a 60 s interval samples on the minute and 900 s on the quarter hours, on every device.
+// The RTCC alarm marks each slot; the ESP timer, which drifts, only bounds the wait if the alarm fails.
+class WakeSchedule {
+   public:
+    WakeSchedule();
+    ~WakeSchedule();
+    // Start of the first slot after now. Intervals that do not divide a day restart at midnight.
+    static time_t nextSlot(time_t now, uint32_t interval);
+    // Programs the RTCC alarm for the next slot and returns it.
+    time_t arm(time_t now, uint32_t interval);
+    // Records how the wait for a slot ended and clears the alarm.
+    void woke(bool byAlarm);
+
+    uint32_t alarmWakes;  // Since boot
+    uint32_t timerWakes;  // Alarm missing, the ESP timer ended the wait
+};
+
+extern WakeSchedule wakeSchedule;
+#endif
@@ -0,0 +1,82 @@
+#include <Adafruit_MCP23017.h>
+
+#include "hostsim.h"
+
+// Bytes on the bus, address included
+#define MCP_READREG_BYTES (2 + 2)  // Register pointer write, then a one byte read
+#define MCP_WRITEREG_BYTES 3
+
+Adafruit_MCP23017::Adafruit_MCP23017() {
+    iodir = 0xffff;
+    olat = 0;
+    inputs = 0;
+}
+
+void Adafruit_MCP23017::begin(uint8_t addr) {
+    simI2CTransaction(MCP_WRITEREG_BYTES);
+    simI2CTransaction(MCP_WRITEREG_BYTES);
+    iodir = 0xffff;
+}
+
+void Adafruit_MCP23017::pinMode(uint8_t p, uint8_t d) {
+    simI2CTransaction(2);
+    simI2CTransaction(2);
+    simI2CTransaction(MCP_WRITEREG_BYTES);
+    if (d == INPUT) {
+        iodir |= (1 << p);
+    } else {
+        iodir &= ~(1 << p);
+    }
+}
+
+void Adafruit_MCP23017::digitalWrite(uint8_t p, uint8_t d) {
+    // Read OLAT, modify, write GPIO
+    simI2CTransaction(2);
+    simI2CTransaction(2);
+    simI2CTransaction(MCP_WRITEREG_BYTES);
+    setLatch(d ? olat | (1 << p) : olat & ~(1 << p));
+}
+
+void Adafruit_MCP23017::pullUp(uint8_t p, uint8_t d) {
+    simI2CTransaction(2);
+    simI2CTransaction(2);
+    simI2CTransaction(MCP_WRITEREG_BYTES);
+}
+
+uint8_t Adafruit_MCP23017::digitalRead(uint8_t p) {
+    return (readGPIO(p / 8) >> (p % 8)) & 0x01;
+}
+
+void Adafruit_MCP23017::writeGPIOAB(uint16_t ba) {
+    simI2CTransaction(4);
+    setLatch(ba);
+}
+
+uint16_t Adafruit_MCP23017::readGPIOAB(void) {
+    simI2CTransaction(2);
+    simI2CTransaction(3);
+    return (inputs & iodir) | (olat & ~iodir);
+}
+
+uint8_t Adafruit_MCP23017::readGPIO(uint8_t b) {
+    simI2CTransaction(2);
+    simI2CTransaction(2);
+    uint16_t gpio = (inputs & iodir) | (olat & ~iodir);
+    return b ? gpio >> 8 : gpio & 0xff;
+}
+
+void Adafruit_MCP23017::simSetInput(uint8_t p, bool high) {
+    if (high) {
+        inputs |= (1 << p);
+    } else {
+        inputs &= ~(1 << p);
+    }
+}
+
+void Adafruit_MCP23017::setLatch(uint16_t latch) {
+    uint16_t changed = (olat ^ latch) & ~iodir;
+    olat = latch;
+    for (uint8_t p = 0; p < 16; p++) {
+        if (changed & (1 << p)) simChipSelect(p, !(latch & (1 << p)));
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef HOSTSIM_ADAFRUIT_MCP23017_H_
+#define HOSTSIM_ADAFRUIT_MCP23017_H_
+#include <Arduino.h>
+
+// Same API and I2C transaction pattern as Adafruit MCP23017 Arduino Library 1.x.
+// Output latch changes on pins with an attached SPI device act as chip selects.
+class Adafruit_MCP23017 {
+   public:
+    Adafruit_MCP23017();
+    void begin(uint8_t addr = 0);
+    void pinMode(uint8_t p, uint8_t d);
+    void digitalWrite(uint8_t p, uint8_t d);
+    void pullUp(uint8_t p, uint8_t d);
+    uint8_t digitalRead(uint8_t p);
+    void writeGPIOAB(uint16_t ba);
+    uint16_t readGPIOAB(void);
+    uint8_t readGPIO(uint8_t b);
+
+    void simSetInput(uint8_t p, bool high);
+
+   private:
+    void setLatch(uint16_t latch);
+    uint16_t iodir;
+    uint16_t olat;
+    uint16_t inputs;
+};
+#endif
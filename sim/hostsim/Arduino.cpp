@@ -0,0 +1,238 @@
+#include <Arduino.h>
+#include <stdio.h>
+
+#include "hostsim.h"
+
+#define SIM_YIELD_US 10          // Lets polling loops make progress in virtual time
+#define SIM_UART_FIFO 128
+#define SIM_RTC_USER_BLOCKS 128  // 512 bytes of RTC user memory
+
+HardwareSerial Serial;
+EspClass ESP;
+SimStats simStats;
+
+static uint64_t nowUs = 0;
+static uint16_t analogValue = 0;
+static uint32_t rtcUserMemory[SIM_RTC_USER_BLOCKS];
+
+uint64_t simMicros(void) {
+    return nowUs;
+}
+
+void simAdvance(uint64_t us) {
+    nowUs += us;
+}
+
+void simResetStats(void) {
+    memset(&simStats, 0, sizeof(simStats));
+}
+
+void simPrintStats(void) {
+    printf("  SPI calls:          %u\n", simStats.spiCalls);
+    printf("  SPI bytes:          %u\n", simStats.spiBytes);
+    printf("  I2C transactions:   %u\n", simStats.i2cTransactions);
+    printf("  I2C bytes:          %u\n", simStats.i2cBytes);
+    printf("  EEPROM page writes: %u\n", simStats.eepromPageWrites);
+    printf("  EEPROM busy polls:  %u\n", simStats.eepromStatusPolls);
+    printf("  Serial bytes:       %u\n", simStats.serialBytes);
+}
+
+void simSetAnalog(uint16_t value) {
+    analogValue = value;
+}
+
+void simSerialInput(const char* text) {
+    Serial.simInput(text);
+}
+
+void simSerialEcho(bool enabled) {
+    Serial.echo = enabled;
+}
+
+unsigned long millis(void) {
+    return nowUs / 1000;
+}
+
+unsigned long micros(void) {
+    return nowUs;
+}
+
+void delay(unsigned long ms) {
+    nowUs += ms * 1000ULL;
+}
+
+void delayMicroseconds(unsigned int us) {
+    nowUs += us;
+}
+
+void yield(void) {
+    nowUs += SIM_YIELD_US;
+}
+
+int analogRead(uint8_t pin) {
+    nowUs += 100;  // ESP8266 ADC conversion time
+    return analogValue;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+int digitalRead(uint8_t pin) {
+    return HIGH;
+}
+
+long random(long max) {
+    return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+    srand(seed);
+}
+
+size_t Print::write(const uint8_t* buf, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buf++);
+    return n;
+}
+
+size_t Print::printNumber(unsigned long long n, int base) {
+    char buf[8 * sizeof(n) + 1];
+    char* str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    if (base < 2) base = 10;
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return write(str);
+}
+
+size_t Print::printSigned(long long n, int base) {
+    if (base == DEC && n < 0) return print('-') + printNumber(-n, base);
+    return printNumber((unsigned long long)n, base);
+}
+
+size_t Print::print(double n, int digits) {
+    char buf[48];
+    if (isnan(n)) return write("nan");
+    if (isinf(n)) return write("inf");
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return write(buf);
+}
+
+int Stream::timedRead(void) {
+    unsigned long start = millis();
+    do {
+        if (available()) return read();
+        delay(1);
+    } while (millis() - start < timeout);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0) break;
+        *buffer++ = (char)c;
+        count++;
+    }
+    return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0 || c == terminator) break;
+        *buffer++ = (char)c;
+        count++;
+    }
+    return count;
+}
+
+HardwareSerial::HardwareSerial() {
+    echo = false;
+    baud = 115200;
+    txDoneAt = 0;
+    rxHead = rxTail = 0;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+    this->baud = baud;
+}
+
+int HardwareSerial::availableForWrite(void) {
+    uint64_t byteUs = 10000000ULL / baud;
+    if (txDoneAt <= nowUs) return SIM_UART_FIFO;
+    uint64_t queued = (txDoneAt - nowUs + byteUs - 1) / byteUs;
+    return queued >= SIM_UART_FIFO ? 0 : SIM_UART_FIFO - queued;
+}
+
+void HardwareSerial::flush(void) {
+    if (txDoneAt > nowUs) nowUs = txDoneAt;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    // Writes block once the UART FIFO is full, just like on the device.
+    uint64_t byteUs = 10000000ULL / baud;
+    if (txDoneAt < nowUs) txDoneAt = nowUs;
+    txDoneAt += byteUs;
+    if (txDoneAt - nowUs > SIM_UART_FIFO * byteUs) nowUs = txDoneAt - SIM_UART_FIFO * byteUs;
+    simStats.serialBytes++;
+    if (echo) putchar(c);
+    return 1;
+}
+
+int HardwareSerial::available(void) {
+    return (rxHead - rxTail + sizeof(rxBuffer)) % sizeof(rxBuffer);
+}
+
+int HardwareSerial::read(void) {
+    if (rxHead == rxTail) return -1;
+    char c = rxBuffer[rxTail];
+    rxTail = (rxTail + 1) % sizeof(rxBuffer);
+    return (uint8_t)c;
+}
+
+int HardwareSerial::peek(void) {
+    if (rxHead == rxTail) return -1;
+    return (uint8_t)rxBuffer[rxTail];
+}
+
+void HardwareSerial::simInput(const char* text) {
+    while (*text) {
+        size_t next = (rxHead + 1) % sizeof(rxBuffer);
+        if (next == rxTail) break;
+        rxBuffer[rxHead] = *text++;
+        rxHead = next;
+    }
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+    if (offset + (size + 3) / 4 > SIM_RTC_USER_BLOCKS) return false;
+    memcpy(data, &rtcUserMemory[offset], size);
+    return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+    if (offset + (size + 3) / 4 > SIM_RTC_USER_BLOCKS) return false;
+    memcpy(&rtcUserMemory[offset], data, size);
+    return true;
+}
+
+void EspClass::deepSleep(uint64_t timeUs, RFMode mode) {
+    resetInfo.reason = REASON_DEEP_SLEEP_AWAKE;
+    throw SimReset{timeUs};
+}
+
+void EspClass::restart(void) {
+    resetInfo.reason = REASON_SOFT_RESTART;
+    throw SimReset{0};
+}
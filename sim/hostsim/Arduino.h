@@ -0,0 +1,150 @@
+#ifndef HOSTSIM_ARDUINO_H_
+#define HOSTSIM_ARDUINO_H_
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+#define DEC 10
+#define HEX 16
+#define A0 17
+
+#define PROGMEM
+#define F(s) (s)
+
+#define RF_DEFAULT 0
+#define RF_CAL 1
+#define RF_NO_CAL 2
+#define RF_DISABLED 4
+typedef int RFMode;
+
+// rst_info reasons, as in the SDK's user_interface.h
+#define REASON_DEFAULT_RST 0
+#define REASON_SOFT_RESTART 4
+#define REASON_DEEP_SLEEP_AWAKE 5
+
+struct rst_info {
+    uint32_t reason;
+};
+
+inline uint16_t word(uint8_t h, uint8_t l) { return (h << 8) | l; }
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+int analogRead(uint8_t pin);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class Print {
+   public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buf, size_t size) { return write((const uint8_t*)buf, size); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long long n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned long long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double n, int digits = 2);
+
+    size_t println(void) { return write("\r\n"); }
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(T value, int format) { return print(value, format) + println(); }
+
+    void flush(void) {}
+
+   private:
+    size_t printNumber(unsigned long long n, int base);
+    size_t printSigned(long long n, int base);
+};
+
+class Stream : public Print {
+   public:
+    Stream() { timeout = 1000; }
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+    void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    size_t readBytesUntil(char terminator, char* buffer, size_t length);
+    size_t readBytesUntil(char terminator, uint8_t* buffer, size_t length) { return readBytesUntil(terminator, (char*)buffer, length); }
+
+   protected:
+    int timedRead(void);
+    unsigned long timeout;
+};
+
+class HardwareSerial : public Stream {
+   public:
+    HardwareSerial();
+    void begin(unsigned long baud);
+    void updateBaudRate(unsigned long baud) { begin(baud); }
+    int availableForWrite(void);
+    void flush(void);
+    size_t write(uint8_t c) override;
+    using Print::write;
+    int available(void) override;
+    int read(void) override;
+    int peek(void) override;
+    operator bool() { return true; }
+
+    void simInput(const char* text);
+    bool echo;
+
+   private:
+    unsigned long baud;
+    uint64_t txDoneAt;  // When the last byte written leaves the UART
+    char rxBuffer[256];
+    size_t rxHead;
+    size_t rxTail;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+   public:
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+    void deepSleep(uint64_t timeUs, RFMode mode = RF_DEFAULT);
+    void deepSleepInstant(uint64_t timeUs, RFMode mode = RF_DEFAULT) { deepSleep(timeUs, mode); }
+    uint64_t deepSleepMax(void) { return 12000000000ULL; }
+    void restart(void);
+    uint32_t getFreeHeap(void) { return 40000; }
+    uint32_t getMaxFreeBlockSize(void) { return 30000; }
+    rst_info* getResetInfoPtr(void) { return &resetInfo; }
+    uint32_t getChipId(void) { return 0x00beef; }
+    uint32_t random(void) { return ::rand(); }
+
+    rst_info resetInfo = {REASON_DEFAULT_RST};  // Set by deepSleep and restart for the next boot
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,8 @@
+#include <CRC32.h>
+
+void CRC32::update(const uint8_t& data) {
+    state ^= data;
+    for (int bit = 0; bit < 8; bit++) {
+        state = (state >> 1) ^ (0xEDB88320 & (0 - (state & 1)));
+    }
+}
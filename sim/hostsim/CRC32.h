@@ -0,0 +1,29 @@
+#ifndef HOSTSIM_CRC32_H_
+#define HOSTSIM_CRC32_H_
+#include <stddef.h>
+#include <stdint.h>
+
+// Standard CRC-32, same API and results as bakercp/CRC32.
+class CRC32 {
+   public:
+    CRC32() { reset(); }
+    void reset(void) { state = ~0U; }
+    void update(const uint8_t& data);
+    template <typename Type>
+    void update(const Type* data, size_t size) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size * sizeof(Type); i++) update(bytes[i]);
+    }
+    uint32_t finalize(void) const { return ~state; }
+
+    template <typename Type>
+    static uint32_t calculate(const Type* data, size_t size) {
+        CRC32 crc;
+        crc.update(data, size);
+        return crc.finalize();
+    }
+
+   private:
+    uint32_t state;
+};
+#endif
@@ -0,0 +1,55 @@
+#include <SPI.h>
+
+#include "hostsim.h"
+
+#define SIM_SPI_CALL_OVERHEAD_NS 1500  // Function call and FIFO round trip per driver call
+
+SPIClass SPI;
+
+SPIClass::SPIClass() {
+    clock = 1000000;
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+    clock = settings.clock;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    account(1);
+    SimSpiDevice* device = simSelectedSpiDevice();
+    return device ? device->transfer(data) : 0xff;
+}
+
+uint16_t SPIClass::transfer16(uint16_t data) {
+    account(2);
+    SimSpiDevice* device = simSelectedSpiDevice();
+    if (!device) return 0xffff;
+    uint16_t in = device->transfer(data >> 8) << 8;
+    return in | device->transfer(data & 0xff);
+}
+
+void SPIClass::transfer(void* buf, uint16_t count) {
+    transferBytes((uint8_t*)buf, (uint8_t*)buf, count);
+}
+
+void SPIClass::transferBytes(const uint8_t* out, uint8_t* in, uint32_t size) {
+    account(size);
+    SimSpiDevice* device = simSelectedSpiDevice();
+    for (uint32_t i = 0; i < size; i++) {
+        uint8_t b = device ? device->transfer(out ? out[i] : 0xff) : 0xff;
+        if (in) in[i] = b;
+    }
+}
+
+void SPIClass::writeBytes(const uint8_t* data, uint32_t size) {
+    transferBytes(data, NULL, size);
+}
+
+void SPIClass::account(uint32_t bytes) {
+    simStats.spiCalls++;
+    simStats.spiBytes += bytes;
+    static uint64_t nsRemainder = 0;
+    nsRemainder += SIM_SPI_CALL_OVERHEAD_NS + (uint64_t)bytes * 8 * 1000000000ULL / clock;
+    simAdvance(nsRemainder / 1000);
+    nsRemainder %= 1000;
+}
@@ -0,0 +1,37 @@
+#ifndef HOSTSIM_SPI_H_
+#define HOSTSIM_SPI_H_
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+
+class SPISettings {
+   public:
+    SPISettings() : clock(1000000) {}
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock) {}
+    uint32_t clock;
+};
+
+// Each call costs a fixed driver overhead plus the time to clock the bits out.
+class SPIClass {
+   public:
+    SPIClass();
+    void begin(void) {}
+    void end(void) {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction(void) {}
+    void setFrequency(uint32_t freq) { clock = freq; }
+    uint8_t transfer(uint8_t data);
+    uint16_t transfer16(uint16_t data);
+    void transfer(void* buf, uint16_t count);
+    void transferBytes(const uint8_t* out, uint8_t* in, uint32_t size);
+    void writeBytes(const uint8_t* data, uint32_t size);
+
+   private:
+    void account(uint32_t bytes);
+    uint32_t clock;
+};
+
+extern SPIClass SPI;
+#endif
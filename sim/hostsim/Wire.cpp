@@ -0,0 +1,77 @@
+#include <Wire.h>
+
+#include "hostsim.h"
+
+#define SIM_I2C_BITS_PER_BYTE 9  // 8 data bits and ACK
+#define SIM_I2C_OVERHEAD_US 10   // Start/stop conditions and driver overhead
+
+TwoWire Wire;
+
+void simI2CTransaction(size_t bytes) {
+    simStats.i2cTransactions++;
+    simStats.i2cBytes += bytes;
+    simAdvance(SIM_I2C_OVERHEAD_US + (uint64_t)bytes * SIM_I2C_BITS_PER_BYTE * 1000000ULL / Wire.getClock());
+}
+
+TwoWire::TwoWire() {
+    clock = 100000;
+    txAddress = 0;
+    txLength = 0;
+    rxLength = 0;
+    rxIndex = 0;
+}
+
+void TwoWire::setClock(uint32_t clock) {
+    this->clock = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    txAddress = address;
+    txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+    simI2CTransaction(1 + txLength);
+    SimI2CDevice* device = simGetI2CDevice(txAddress);
+    if (!device) return 2;  // NACK on address
+    device->write(txBuffer, txLength);
+    txLength = 0;
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+    if (quantity > WIRE_BUFFER_LENGTH) quantity = WIRE_BUFFER_LENGTH;
+    simI2CTransaction(1 + quantity);
+    rxIndex = 0;
+    rxLength = 0;
+    SimI2CDevice* device = simGetI2CDevice(address);
+    if (!device) return 0;
+    rxLength = device->read(rxBuffer, quantity);
+    return rxLength;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (txLength >= WIRE_BUFFER_LENGTH) return 0;
+    txBuffer[txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+    size_t n = 0;
+    while (quantity--) n += write(*data++);
+    return n;
+}
+
+int TwoWire::available(void) {
+    return rxLength - rxIndex;
+}
+
+int TwoWire::read(void) {
+    if (rxIndex >= rxLength) return -1;
+    return rxBuffer[rxIndex++];
+}
+
+int TwoWire::peek(void) {
+    if (rxIndex >= rxLength) return -1;
+    return rxBuffer[rxIndex];
+}
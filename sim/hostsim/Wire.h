@@ -0,0 +1,41 @@
+#ifndef HOSTSIM_WIRE_H_
+#define HOSTSIM_WIRE_H_
+#include <Arduino.h>
+
+#define WIRE_BUFFER_LENGTH 128
+
+class TwoWire : public Stream {
+   public:
+    TwoWire();
+    void begin(void) {}
+    void begin(int sda, int scl) {}
+    void setClock(uint32_t clock);
+    uint32_t getClock(void) { return clock; }
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(uint8_t sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* data, size_t quantity) override;
+    size_t write(int n) { return write((uint8_t)n); }
+    size_t write(unsigned int n) { return write((uint8_t)n); }
+    size_t write(long n) { return write((uint8_t)n); }
+    size_t write(unsigned long n) { return write((uint8_t)n); }
+    using Print::write;
+    int available(void) override;
+    int read(void) override;
+    int peek(void) override;
+
+   private:
+    uint32_t clock;
+    uint8_t txAddress;
+    uint8_t txBuffer[WIRE_BUFFER_LENGTH];
+    size_t txLength;
+    uint8_t rxBuffer[WIRE_BUFFER_LENGTH];
+    size_t rxLength;
+    size_t rxIndex;
+};
+
+extern TwoWire Wire;
+#endif
@@ -0,0 +1,60 @@
+#ifndef HOSTSIM_H_
+#define HOSTSIM_H_
+#include <stddef.h>
+#include <stdint.h>
+
+// Virtual time, only advanced by delays, bus transfers and serial output.
+uint64_t simMicros(void);
+void simAdvance(uint64_t us);
+
+// Bus activity since start or the last simResetStats()
+struct SimStats {
+    uint32_t spiCalls;      // Calls into the SPI driver
+    uint32_t spiBytes;      // Bytes clocked on the SPI bus
+    uint32_t i2cTransactions;
+    uint32_t i2cBytes;      // Bytes on the I2C bus, including addresses
+    uint32_t eepromPageWrites;
+    uint32_t eepromStatusPolls;
+    uint32_t serialBytes;
+};
+
+extern SimStats simStats;
+void simResetStats(void);
+void simPrintStats(void);
+
+// Devices on the simulated buses
+class SimSpiDevice {
+   public:
+    virtual ~SimSpiDevice() {}
+    virtual void select(void) = 0;
+    virtual void deselect(void) = 0;
+    virtual uint8_t transfer(uint8_t out) = 0;
+};
+
+class SimI2CDevice {
+   public:
+    virtual ~SimI2CDevice() {}
+    virtual void write(const uint8_t* data, size_t len) = 0;
+    virtual size_t read(uint8_t* data, size_t len) = 0;
+};
+
+// Chip selects are driven through the MCP23017, so SPI devices are attached to expander pins.
+void simAttachSpiDevice(SimSpiDevice* device, uint8_t expanderPin);
+void simAttachI2CDevice(SimI2CDevice* device, uint8_t address);
+SimI2CDevice* simGetI2CDevice(uint8_t address);
+void simChipSelect(uint8_t expanderPin, bool low);
+SimSpiDevice* simSelectedSpiDevice(void);
+// Accounts one I2C transaction of the given number of bytes, address byte included.
+void simI2CTransaction(size_t bytes);
+
+// Inputs
+void simSetAnalog(uint16_t value);
+void simSerialInput(const char* text);
+void simSerialEcho(bool enabled);  // Print firmware serial output to stdout
+
+// Thrown by ESP.deepSleep() and ESP.restart(), the runner catches it and boots again.
+struct SimReset {
+    uint64_t sleepUs;
+};
+
+#endif
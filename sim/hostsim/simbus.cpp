@@ -0,0 +1,36 @@
+#include "hostsim.h"
+
+#define SIM_EXPANDER_PINS 16
+#define SIM_I2C_ADDRESSES 128
+
+static SimSpiDevice* spiDevices[SIM_EXPANDER_PINS];
+static SimI2CDevice* i2cDevices[SIM_I2C_ADDRESSES];
+static SimSpiDevice* selected = 0;
+
+void simAttachSpiDevice(SimSpiDevice* device, uint8_t expanderPin) {
+    if (expanderPin < SIM_EXPANDER_PINS) spiDevices[expanderPin] = device;
+}
+
+void simAttachI2CDevice(SimI2CDevice* device, uint8_t address) {
+    if (address < SIM_I2C_ADDRESSES) i2cDevices[address] = device;
+}
+
+SimI2CDevice* simGetI2CDevice(uint8_t address) {
+    return address < SIM_I2C_ADDRESSES ? i2cDevices[address] : 0;
+}
+
+void simChipSelect(uint8_t expanderPin, bool low) {
+    if (expanderPin >= SIM_EXPANDER_PINS || !spiDevices[expanderPin]) return;
+    SimSpiDevice* device = spiDevices[expanderPin];
+    if (low) {
+        selected = device;
+        device->select();
+    } else {
+        device->deselect();
+        if (selected == device) selected = 0;
+    }
+}
+
+SimSpiDevice* simSelectedSpiDevice(void) {
+    return selected;
+}
@@ -0,0 +1,110 @@
+#include "simeeprom.h"
+
+#include <string.h>
+
+#define CMD_READ 0x03
+#define CMD_WRITE 0x02
+#define CMD_WRDI 0x04
+#define CMD_WREN 0x06
+#define CMD_RDSR 0x05
+#define CMD_WRSR 0x01
+
+SimEEPROM::SimEEPROM() {
+    memset(memory, 0xff, sizeof(memory));
+    memset(pageWrites, 0, sizeof(pageWrites));
+    command = 0;
+    status = 0;
+    position = 0;
+    address = 0;
+    writePending = false;
+    busyUntil = 0;
+}
+
+bool SimEEPROM::busy(void) {
+    return simMicros() < busyUntil;
+}
+
+void SimEEPROM::select(void) {
+    command = 0;
+    position = 0;
+    writePending = false;
+    memset(pageBufferDirty, 0, sizeof(pageBufferDirty));
+}
+
+void SimEEPROM::deselect(void) {
+    if (busy() || position == 0) return;
+
+    switch (command) {
+        case CMD_WREN:
+            status |= SIMEEPROM_STATUS_WEL;
+            break;
+        case CMD_WRDI:
+            status &= ~SIMEEPROM_STATUS_WEL;
+            break;
+        case CMD_WRITE:
+            if (!writePending) break;
+            // Write cycle starts on the rising edge of CS.
+            for (int i = 0; i < SIMEEPROM_PAGESIZE; i++) {
+                if (pageBufferDirty[i]) memory[(address & ~(SIMEEPROM_PAGESIZE - 1)) + i] = pageBuffer[i];
+            }
+            pageWrites[address / SIMEEPROM_PAGESIZE]++;
+            simStats.eepromPageWrites++;
+            status &= ~SIMEEPROM_STATUS_WEL;
+            busyUntil = simMicros() + SIMEEPROM_WRITE_CYCLE_US;
+            break;
+    }
+}
+
+uint8_t SimEEPROM::transfer(uint8_t out) {
+    uint32_t pos = position++;
+    if (pos == 0) {
+        command = out;
+        if (command == CMD_RDSR) simStats.eepromStatusPolls++;
+        return 0xff;
+    }
+
+    if (command == CMD_RDSR) {
+        return status | (busy() ? SIMEEPROM_STATUS_WIP : 0);
+    }
+    if (busy()) return 0xff;  // Everything but RDSR is ignored during a write cycle
+
+    switch (command) {
+        case CMD_READ:
+        case CMD_WRITE:
+            if (pos == 1) {
+                address = out << 8;
+                return 0xff;
+            }
+            if (pos == 2) {
+                address = (address | out) % SIMEEPROM_SIZE;
+                return 0xff;
+            }
+            if (command == CMD_READ) {
+                // Sequential read continues across pages and wraps at the end of the array.
+                uint8_t in = memory[address];
+                address = (address + 1) % SIMEEPROM_SIZE;
+                return in;
+            }
+            if (!(status & SIMEEPROM_STATUS_WEL)) return 0xff;
+            {
+                // Page write wraps around within the page.
+                uint16_t offset = (address + (pos - 3)) % SIMEEPROM_PAGESIZE;
+                pageBuffer[offset] = out;
+                pageBufferDirty[offset] = true;
+                writePending = true;
+            }
+            return 0xff;
+        case CMD_WRSR:
+            if (pos == 1 && (status & SIMEEPROM_STATUS_WEL)) status = (status & 0x03) | (out & 0x8c);
+            return 0xff;
+    }
+    return 0xff;
+}
+
+uint32_t SimEEPROM::maxPageWrites(void) {
+    uint32_t max = 0;
+    for (uint32_t p = 0; p < SIMEEPROM_SIZE / SIMEEPROM_PAGESIZE; p++) {
+        if (pageWrites[p] > max) max = pageWrites[p];
+    }
+    return max;
+}
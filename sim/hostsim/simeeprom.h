@@ -0,0 +1,39 @@
+#ifndef SIMEEPROM_H_
+#define SIMEEPROM_H_
+#include <stdint.h>
+
+#include "hostsim.h"
+
+#define SIMEEPROM_SIZE 32768  // 25LC256
+#define SIMEEPROM_PAGESIZE 64
+#define SIMEEPROM_WRITE_CYCLE_US 5000
+
+#define SIMEEPROM_STATUS_WIP 0x01
+#define SIMEEPROM_STATUS_WEL 0x02
+
+// Behavioral model of a 25xx SPI EEPROM: status register with WIP/WEL, page write buffer
+// that wraps within the page, and a busy period after each write where only RDSR is accepted.
+class SimEEPROM : public SimSpiDevice {
+   public:
+    SimEEPROM();
+    void select(void);
+    void deselect(void);
+    uint8_t transfer(uint8_t out);
+
+    bool busy(void);
+    uint32_t maxPageWrites(void);
+
+    uint8_t memory[SIMEEPROM_SIZE];
+    uint32_t pageWrites[SIMEEPROM_SIZE / SIMEEPROM_PAGESIZE];
+
+   private:
+    uint8_t command;
+    uint8_t status;
+    uint32_t position;  // Bytes received since select
+    uint16_t address;
+    uint8_t pageBuffer[SIMEEPROM_PAGESIZE];
+    bool pageBufferDirty[SIMEEPROM_PAGESIZE];
+    bool writePending;
+    uint64_t busyUntil;
+};
+#endif
@@ -0,0 +1,164 @@
+#include "simrtcc.h"
+
+#include <string.h>
+
+#define REG_RTCSEC 0x00
+#define REG_RTCWKDAY 0x03
+#define REG_RTCYEAR 0x06
+#define REG_CONTROL 0x07
+#define REG_ALM0SEC 0x0a
+#define REG_ALM0WKDAY 0x0d
+#define REG_PWRDN 0x18
+#define REG_PWRUP 0x1c
+
+#define RTCSEC_ST 0x80
+#define RTCWKDAY_OSCRUN 0x20
+#define RTCWKDAY_PWRFAIL 0x10
+#define CONTROL_ALM0EN 0x10
+#define ALMWKDAY_IF 0x08
+
+static uint8_t toBcd(int v) {
+    return ((v / 10) << 4) | (v % 10);
+}
+
+static int fromBcd(uint8_t v) {
+    return (v >> 4) * 10 + (v & 0x0f);
+}
+
+SimRTCC::SimRTCC() {
+    memset(regs, 0, sizeof(regs));
+    memset(sram, 0, sizeof(sram));
+    pointer = 0;
+    running = false;
+    alarmArmed = false;
+    epoch = 0;
+    epochMicros = 0;
+}
+
+void SimRTCC::start(time_t now) {
+    epoch = now;
+    epochMicros = simMicros();
+    running = true;
+    regs[REG_RTCSEC] |= RTCSEC_ST;
+    regs[REG_RTCWKDAY] |= RTCWKDAY_OSCRUN | 0x08;  // VBATEN
+    refreshTime();
+}
+
+time_t SimRTCC::now(void) {
+    if (!running) return epoch;
+    return epoch + (simMicros() - epochMicros) / 1000000;
+}
+
+void SimRTCC::powerFail(time_t down, time_t up) {
+    regs[REG_RTCWKDAY] |= RTCWKDAY_PWRFAIL;
+    writeTimestamp(REG_PWRDN, down);
+    writeTimestamp(REG_PWRUP, up);
+}
+
+void SimRTCC::write(const uint8_t* data, size_t len) {
+    if (len == 0) return;
+    pointer = data[0];
+    bool timeWritten = false;
+    for (size_t i = 1; i < len; i++) {
+        uint8_t* r = reg(pointer);
+        if (r) {
+            if (pointer == REG_RTCWKDAY) {
+                // OSCRUN is read only, PWRFAIL can only be cleared.
+                uint8_t keep = *r & RTCWKDAY_OSCRUN;
+                uint8_t pwrfail = *r & data[i] & RTCWKDAY_PWRFAIL;
+                *r = (data[i] & ~(RTCWKDAY_OSCRUN | RTCWKDAY_PWRFAIL)) | keep | pwrfail;
+            } else {
+                *r = data[i];
+            }
+            if (pointer <= REG_RTCYEAR) timeWritten = true;
+            if (pointer == REG_ALM0WKDAY) alarmArmed = !(data[i] & ALMWKDAY_IF);
+        }
+        pointer = pointer >= SIMRTCC_SRAM_START ? SIMRTCC_SRAM_START + ((pointer + 1 - SIMRTCC_SRAM_START) % SIMRTCC_SRAM_SIZE)
+                                                : (pointer + 1) % SIMRTCC_REGISTERS;
+    }
+    if (timeWritten) latchTime();
+}
+
+size_t SimRTCC::read(uint8_t* data, size_t len) {
+    refreshTime();
+    for (size_t i = 0; i < len; i++) {
+        uint8_t* r = reg(pointer);
+        data[i] = r ? *r : 0;
+        pointer = pointer >= SIMRTCC_SRAM_START ? SIMRTCC_SRAM_START + ((pointer + 1 - SIMRTCC_SRAM_START) % SIMRTCC_SRAM_SIZE)
+                                                : (pointer + 1) % SIMRTCC_REGISTERS;
+    }
+    return len;
+}
+
+uint8_t* SimRTCC::reg(uint8_t address) {
+    if (address < SIMRTCC_REGISTERS) return &regs[address];
+    if (address < SIMRTCC_SRAM_START + SIMRTCC_SRAM_SIZE) return &sram[address - SIMRTCC_SRAM_START];
+    return 0;
+}
+
+// Registers were written, take them as the new time and start/stop the oscillator per ST.
+void SimRTCC::latchTime(void) {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_sec = fromBcd(regs[0] & 0x7f);
+    t.tm_min = fromBcd(regs[1] & 0x7f);
+    t.tm_hour = fromBcd(regs[2] & 0x3f);
+    t.tm_mday = fromBcd(regs[4] & 0x3f);
+    t.tm_mon = fromBcd(regs[5] & 0x1f) - 1;
+    t.tm_year = fromBcd(regs[6]) + 100;
+    epoch = timegm(&t);
+    epochMicros = simMicros();
+    running = regs[REG_RTCSEC] & RTCSEC_ST;
+    if (running) {
+        regs[REG_RTCWKDAY] |= RTCWKDAY_OSCRUN;
+    } else {
+        regs[REG_RTCWKDAY] &= ~RTCWKDAY_OSCRUN;
+    }
+}
+
+// Update the timekeeping registers from virtual time.
+void SimRTCC::refreshTime(void) {
+    if (!running) return;
+    time_t current = now();
+    struct tm t;
+    gmtime_r(&current, &t);
+    regs[0] = RTCSEC_ST | toBcd(t.tm_sec);
+    regs[1] = toBcd(t.tm_min);
+    regs[2] = toBcd(t.tm_hour);
+    regs[3] = (regs[3] & 0xf8) | (t.tm_wday + 1);
+    regs[4] = toBcd(t.tm_mday);
+    regs[5] = toBcd(t.tm_mon + 1);
+    regs[6] = toBcd(t.tm_year % 100);
+    // Fires once the time has reached the alarm, the flag stays set until written 0.
+    if (alarmArmed && (regs[REG_CONTROL] & CONTROL_ALM0EN) && current >= alarmTime()) {
+        regs[REG_ALM0WKDAY] |= ALMWKDAY_IF;
+        alarmArmed = false;
+    }
+}
+
+uint64_t SimRTCC::alarmMicros(void) {
+    if (!running || !alarmArmed || !(regs[REG_CONTROL] & CONTROL_ALM0EN)) return 0;
+    return epochMicros + (uint64_t)(alarmTime() - epoch) * 1000000;
+}
+
+// Alarm 0 as a time in the current year, the registers hold no year.
+time_t SimRTCC::alarmTime(void) {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_sec = fromBcd(regs[REG_ALM0SEC] & 0x7f);
+    t.tm_min = fromBcd(regs[REG_ALM0SEC + 1] & 0x7f);
+    t.tm_hour = fromBcd(regs[REG_ALM0SEC + 2] & 0x3f);
+    t.tm_mday = fromBcd(regs[REG_ALM0SEC + 4] & 0x3f);
+    t.tm_mon = fromBcd(regs[REG_ALM0SEC + 5] & 0x1f) - 1;
+    t.tm_year = fromBcd(regs[REG_RTCYEAR]) + 100;
+    return timegm(&t);
+}
+
+void SimRTCC::writeTimestamp(uint8_t base, time_t time) {
+    struct tm t;
+    gmtime_r(&time, &t);
+    regs[base] = toBcd(t.tm_min);
+    regs[base + 1] = toBcd(t.tm_hour);
+    regs[base + 2] = toBcd(t.tm_mday);
+    regs[base + 3] = ((t.tm_wday + 1) << 5) | toBcd(t.tm_mon + 1);
+}
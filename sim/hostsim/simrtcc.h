@@ -0,0 +1,46 @@
+#ifndef SIMRTCC_H_
+#define SIMRTCC_H_
+#include <stdint.h>
+#include <time.h>
+
+#include "hostsim.h"
+
+#define SIMRTCC_ADDRESS 0x6f
+#define SIMRTCC_REGISTERS 0x20
+#define SIMRTCC_SRAM_START 0x20
+#define SIMRTCC_SRAM_SIZE 64
+
+// Behavioral model of the MCP7940N register map: BCD timekeeping registers driven by virtual time,
+// ST/OSCRUN, PWRFAIL with power down/up timestamps, alarm 0 with its interrupt flag and the 64 byte battery
+// backed SRAM. Alarm 0 only models the full date and time match the firmware uses.
+class SimRTCC : public SimI2CDevice {
+   public:
+    SimRTCC();
+    void write(const uint8_t* data, size_t len);
+    size_t read(uint8_t* data, size_t len);
+
+    // Starts the oscillator at the given time, as if the clock had been set earlier.
+    void start(time_t now);
+    time_t now(void);
+    // Sets PWRFAIL and latches the power down/up timestamps.
+    void powerFail(time_t down, time_t up);
+    // Virtual time in micros at which alarm 0 fires, 0 if it is not armed.
+    uint64_t alarmMicros(void);
+
+    uint8_t regs[SIMRTCC_REGISTERS];
+    uint8_t sram[SIMRTCC_SRAM_SIZE];
+
+   private:
+    uint8_t* reg(uint8_t address);
+    void latchTime(void);
+    void refreshTime(void);
+    void writeTimestamp(uint8_t base, time_t t);
+    time_t alarmTime(void);
+
+    uint8_t pointer;
+    bool running;
+    bool alarmArmed;      // Alarm 0 written and not fired since
+    time_t epoch;         // Time at epochMicros
+    uint64_t epochMicros;
+};
+#endif
@@ -0,0 +1,74 @@
+#include "acquisition.h"
+
+#include <Arduino.h>
+
+#include "log.h"
+#include "trace.h"
+
+Acquisition::Acquisition() {
+    numTasks = 0;
+    memset(&timing, 0, sizeof(timing));
+}
+
+Acquisition::~Acquisition() {}
+
+bool Acquisition::add(SensorTask* task, const char* name) {
+    if (numTasks >= ACQUISITION_MAX_TASKS) return false;
+    tasks[numTasks] = task;
+    names[numTasks] = name;
+    numTasks++;
+    return true;
+}
+
+void Acquisition::run(Measurement& m) {
+    uint8_t pending = 0;  // One bit per task still converting
+    uint32_t runStart = micros();
+    uint32_t deadline = millis() + ACQUISITION_TIMEOUT_MS;
+
+    memset(&timing, 0, sizeof(timing));
+    TRACE_BEGIN(TRACE_SENSORS);
+
+    // Kick off every conversion first so they all run in parallel.
+    for (uint8_t t = 0; t < numTasks; t++) {
+        if (tasks[t]->start()) pending |= (1 << t);
+        timing.started[t] = micros() - runStart;
+    }
+
+    // Collect results in whatever order the sensors finish.
+    while (pending && (int32_t)(millis() - deadline) < 0) {
+        for (uint8_t t = 0; t < numTasks; t++) {
+            if (!(pending & (1 << t))) continue;
+            if (tasks[t]->poll()) {
+                tasks[t]->read(m);
+                timing.done[t] = micros() - runStart;
+                pending &= ~(1 << t);
+            }
+        }
+        logSink.pump();
+        yield();
+    }
+
+    timing.timedOut = pending;
+    timing.total = micros() - runStart;
+    TRACE_END(TRACE_SENSORS);
+}
+
+void Acquisition::printTiming(void) {
+    for (uint8_t t = 0; t < numTasks; t++) {
+        LogDebug::print(names[t]);
+        LogDebug::print(": start ");
+        LogDebug::print(timing.started[t]);
+        LogDebug::print("us, done ");
+        if (timing.timedOut & (1 << t)) {
+            LogDebug::println("TIMEOUT");
+        } else {
+            LogDebug::print(timing.done[t]);
+            LogDebug::println("us");
+        }
+    }
+    LogDebug::print("Acquisition total: ");
+    LogDebug::print(timing.total);
+    LogDebug::println("us");
+}
+
+Acquisition acquisition;
@@ -0,0 +1,84 @@
+#include "aggregator.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+#include "log.h"
+#include "measurementlog.h"
+#include "rtcmem.h"
+#include "settings.h"
+#include "tools.h"
+
+AggregateState::AggregateState() {}
+
+AggregateState::~AggregateState() {}
+
+Aggregator::Aggregator() {}
+
+Aggregator::~Aggregator() {}
+
+void Aggregator::begin(void) {
+    static_assert(sizeof(AggregateState) % RTCMEM_BLOCKSIZE == 0, "AggregateState must fill whole blocks.");
+    static_assert(RTCMEM_AGGREGATE_BLOCK + sizeof(AggregateState) / RTCMEM_BLOCKSIZE <= RTCMEM_BLOCKS, "AggregateState does not fit in RTC memory.");
+    ESP.rtcUserMemoryRead(RTCMEM_AGGREGATE_BLOCK, (uint32_t*)&state, sizeof(state));
+    if (!checkCrcBuf((uint8_t*)&state, sizeof(state))) {
+        reset(0);
+    }
+}
+
+void Aggregator::add(Measurement& m) {
+    uint32_t window = settings.store.aggregatewindow * 60;
+    if (window == 0) return;
+
+    // Windows are aligned to wall clock so all devices summarize the same periods.
+    uint32_t windowStart = m.timestamp - (m.timestamp % window);
+    if (windowStart != state.windowStart) {
+        if (state.samples > 0) emit();
+        reset(windowStart);
+    }
+
+    state.samples++;
+    for (uint8_t c = 0; c < MEASUREMENT_CHANNELS; c++) {
+        float value = m.*Measurement::channels[c].field;
+        if (isnan(value)) continue;
+        if (state.count[c] == 0 || value < state.min[c]) state.min[c] = value;
+        if (state.count[c] == 0 || value > state.max[c]) state.max[c] = value;
+        state.sum[c] += value;
+        state.count[c]++;
+    }
+    save();
+}
+
+void Aggregator::emit(void) {
+    Measurement minimum, maximum, mean;
+    minimum.type = Measurement::TYPE_SUMMARY_MIN;
+    maximum.type = Measurement::TYPE_SUMMARY_MAX;
+    mean.type = Measurement::TYPE_SUMMARY_MEAN;
+    minimum.timestamp = maximum.timestamp = mean.timestamp = state.windowStart;
+    // Settings keep windows within SETTINGS_MAX_WINDOW_SAMPLES, this only caps windows stored before that check.
+    minimum.bits = maximum.bits = mean.bits = state.samples > 0xff ? 0xff : state.samples;
+
+    for (uint8_t c = 0; c < MEASUREMENT_CHANNELS; c++) {
+        if (state.count[c] == 0) continue;  // Left as NaN
+        float Measurement::*field = Measurement::channels[c].field;
+        minimum.*field = state.min[c];
+        maximum.*field = state.max[c];
+        mean.*field = state.sum[c] / state.count[c];
+    }
+
+    if (!measurementLog.append(minimum) || !measurementLog.append(maximum) || !measurementLog.append(mean)) {
+        LogError::println("Failed to store summary");
+    }
+}
+
+void Aggregator::reset(uint32_t windowStart) {
+    memset((uint8_t*)&state, 0, sizeof(state));
+    state.windowStart = windowStart;
+}
+
+void Aggregator::save(void) {
+    updateCrcBuf((uint8_t*)&state, sizeof(state));
+    ESP.rtcUserMemoryWrite(RTCMEM_AGGREGATE_BLOCK, (uint32_t*)&state, sizeof(state));
+}
+
+Aggregator aggregator;
@@ -1,7 +1,13 @@
 #include "barometric.h"
 
+#include "log.h"
+
+#define BMP280_STATUS_MEASURING 0x08
+#define BMP280_MIN_CONVERSION_MS 2  // Status bit is not set immediately after triggering
+
 Barometric::Barometric() {
     haveBmp = false;
+    startedAt = 0;
 }
 
 Barometric::~Barometric() {
@@ -9,21 +15,32 @@ Barometric::~Barometric() {
 
 void Barometric::setup(void) {
     if (!bmp.begin(0x76)) {
-        Serial.println(F("Could not find a valid BMP280 sensor, check wiring!"));
+        LogError::println(F("Could not find a valid BMP280 sensor, check wiring!"));
     } else {
         haveBmp = 1;
-        /* Default settings from datasheet. */
-        bmp.setSampling(Adafruit_BMP280::MODE_NORMAL,     /* Operating Mode. */
-                        Adafruit_BMP280::SAMPLING_X2,     /* Temp. oversampling */
-                        Adafruit_BMP280::SAMPLING_X16,    /* Pressure oversampling */
-                        Adafruit_BMP280::FILTER_X16,      /* Filtering. */
-                        Adafruit_BMP280::STANDBY_MS_500); /* Standby time. */
+        // Sleep between samples, start() triggers each conversion.
+        bmp.setSampling(Adafruit_BMP280::MODE_SLEEP);
     }
 }
 
-void Barometric::measure(Measurement& m) {
-    if (!haveBmp) return;
+bool Barometric::start(void) {
+    if (!haveBmp) return false;
+    /* Default settings from datasheet, in forced mode. */
+    bmp.setSampling(Adafruit_BMP280::MODE_FORCED,     /* Operating Mode. */
+                    Adafruit_BMP280::SAMPLING_X2,     /* Temp. oversampling */
+                    Adafruit_BMP280::SAMPLING_X16,    /* Pressure oversampling */
+                    Adafruit_BMP280::FILTER_X16,      /* Filtering. */
+                    Adafruit_BMP280::STANDBY_MS_500); /* Standby time. */
+    startedAt = millis();
+    return true;
+}
+
+bool Barometric::poll(void) {
+    if (millis() - startedAt < BMP280_MIN_CONVERSION_MS) return false;
+    return !(bmp.getStatus() & BMP280_STATUS_MEASURING);
+}
 
+void Barometric::read(Measurement& m) {
     Adafruit_Sensor *bmp_temp = bmp.getTemperatureSensor();
     Adafruit_Sensor *bmp_pressure = bmp.getPressureSensor();
     sensors_event_t temp_event, pressure_event;
@@ -0,0 +1,50 @@
+#include "battery.h"
+
+#include <Adafruit_MCP23017.h>
+#include <Arduino.h>
+
+#include "pinout.h"
+
+extern Adafruit_MCP23017 ioexpander;
+
+Battery::Battery() {
+    extPower = false;
+    configStrap = false;
+    inputsRead = false;
+}
+
+Battery::~Battery() {}
+
+void Battery::readInputs(void) {
+    // Both ports are read in one transaction, the EEPROM chip selects share port B.
+    uint16_t gpio = ioexpander.readGPIOAB();
+    extPower = (gpio & (1 << IOEXP_EXTPOWR)) != 0;
+    configStrap = (gpio & (1 << IOEXP_CONFIG)) == 0;
+    inputsRead = true;
+}
+
+bool Battery::start(void) {
+    // A boot has already read the inputs for the config strap, that read serves its first sample.
+    if (!inputsRead) readInputs();
+    inputsRead = false;
+    return true;
+}
+
+bool Battery::poll(void) {
+    return true;
+}
+
+void Battery::read(Measurement& m) {
+    uint32_t sum = 0;
+    for (int s = 0; s < BATTERY_OVERSAMPLE; s++) {
+        sum += analogRead(A0);
+    }
+    m.batteryvoltage = (sum / (float)BATTERY_OVERSAMPLE) * BATTERY_DIVIDER_RATIO / BATTERY_ADC_FULLSCALE;
+    if (extPower) {
+        m.bits |= MEASUREMENT_BIT_EXTPOWER;
+    } else {
+        m.bits &= ~MEASUREMENT_BIT_EXTPOWER;
+    }
+}
+
+Battery battery;
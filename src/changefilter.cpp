@@ -0,0 +1,45 @@
+#include "changefilter.h"
+
+#include <math.h>
+
+#include "measurementlog.h"
+#include "rtcc.h"
+#include "settings.h"
+
+ChangeFilter::ChangeFilter() {}
+
+ChangeFilter::~ChangeFilter() {}
+
+ChangeFilter::RESULT ChangeFilter::check(Measurement& m) {
+    Measurement last;
+    if (Clock.store.nextId == 0 || !measurementLog.read(last, Clock.store.nextId - 1)) return RESULT_STORE;
+    if (last.type != Measurement::TYPE_SENSORREAD) return RESULT_STORE;
+
+    RESULT result = RESULT_SKIP;
+    if (m.timestamp - last.timestamp >= (uint32_t)settings.store.maxstoreinterval * 60) result = RESULT_STORE;
+    if ((m.bits ^ last.bits) & MEASUREMENT_BIT_EXTPOWER) result = RESULT_STORE;
+
+    for (uint8_t c = 0; c < MEASUREMENT_CHANNELS; c++) {
+        const Measurement::Channel& channel = Measurement::channels[c];
+        RESULT channelResult = compare(m.*channel.field, last.*channel.field, channel.group);
+        if (channelResult > result) result = channelResult;
+    }
+
+    if (result == RESULT_SKIP) {
+        Clock.store.skippedSamples++;
+        Clock.saveStore();
+    }
+    return result;
+}
+
+ChangeFilter::RESULT ChangeFilter::compare(float current, float last, uint8_t group) {
+    if (isnan(current) && isnan(last)) return RESULT_SKIP;
+    if (isnan(current) || isnan(last)) return RESULT_STORE;  // Sensor came or went
+
+    float change = fabsf(current - last) * 100;
+    if (settings.store.alarm[group] && change >= settings.store.alarm[group]) return RESULT_ALARM;
+    if (change >= settings.store.deadband[group]) return RESULT_STORE;
+    return RESULT_SKIP;
+}
+
+ChangeFilter changeFilter;
@@ -7,15 +7,31 @@
 #include <WiFiUdp.h>
 #include <rBase64.h>
 
+#include "dnscache.h"
 #include "eepromstore.h"
+#include "health.h"
+#include "hmac.h"
+#include "log.h"
 #include "rtcc.h"
 #include "settings.h"
 #include "tools.h"
+#include "trace.h"
 
 // Local helper functions
 void sendNTPpacket(IPAddress& address, WiFiUDP& udp, byte* packetBuffer);
+bool applyConfig(const String& reply, uint32_t version);
 const int NTP_PACKET_SIZE = 48;  // NTP time stamp is in the first 48 bytes of the message
 
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+// status, ack and cfgver of an upload reply with their key text, and room for a short status message
+#define UPLOAD_REPLY_SIZE (JSON_OBJECT_SIZE(3) + 18 + 48)
+#define CONFIG_KEYS 11  // si, sp, sn, sm, sr, sg, sl, so, sc, sd and sa
+#define CONFIG_FILTER_SIZE (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(CONFIG_KEYS))
+// Every config key with its key text, a config with more in it is skipped
+#define CONFIG_SIZE (CONFIG_FILTER_SIZE + 2 * JSON_ARRAY_SIZE(CHANNEL_GROUPS) + 7 + 3 * CONFIG_KEYS)
+#define UDP_UPLOAD_PORT 5684      // Collector port for udp:// URLs without one
+#define UDP_LOCAL_PORT 2391
+
 // DST Root CA X3 (Letsencrypt) - Expires Thursday 30 September 2021 14:01:15
 const char DST_ROOT_CA_X3[] PROGMEM = R"EOF(
 -----BEGIN CERTIFICATE-----
@@ -76,23 +92,36 @@ emyPxgcYxn/eR44/KJ4EBs+lVDR3veyJm+kXQ99b21/+jh5Xos1AnX5iItreGCc=
 -----END CERTIFICATE-----
 )EOF";
 
-Communication::Communication() { begun = false; }
+Communication::Communication() {
+    tokenLoaded = false;
+    begun = false;
+    configApplied = false;
+}
 Communication::~Communication() {}
 
-void Communication::begin(void) {
-    if (begun) return;
+bool Communication::begin(void) {
+    if (begun) return true;
     char baseUrlTemp[65];
+    if (settings.registered) {
+        eepromStore.readPage(deviceToken, EEPROM_DEVICE_TOKEN_PAGE);
+        tokenLoaded = checkCrcBuf(deviceToken, EEPROM_PAGESIZE);
+    }
     eepromStore.readPage((uint8_t*)ssid, EEPROM_FIRST_WIFIPAGE + 2 * Clock.store.lastUsedWifi);
     eepromStore.readPage((uint8_t*)psk, EEPROM_FIRST_WIFIPAGE + 2 * Clock.store.lastUsedWifi + 1);
     eepromStore.readPage((uint8_t*)baseUrlTemp, EEPROM_URL_PAGE);
     baseUrl = String(baseUrlTemp);
     if (!baseUrl.endsWith("/")) baseUrl += "/";
     ssl = false;
+    udp = false;
+    port = 0;
     if (baseUrl.startsWith("https://")) {
         port = 443;
         ssl = true;
     } else if (baseUrl.startsWith("http://")) {
         port = 80;
+    } else if (baseUrl.startsWith("udp://")) {
+        port = UDP_UPLOAD_PORT;
+        udp = true;
     }
     if (port > 0) {
         int startOfServer = baseUrl.indexOf(':') + 3;
@@ -110,19 +139,39 @@ void Communication::begin(void) {
         server = baseUrl.substring(startOfServer, endOfServer);
     }
 
+    WiFi.forceSleepWake();
+    delay(1);
     WiFi.persistent(false);  // Make sure the credentials are NOT stored persistently by the chip as they already are stored in EEPROM.
     WiFi.mode(WIFI_STA);
+    TRACE_BEGIN(TRACE_WIFI);
     WiFi.begin(ssid, psk);
-    Serial.print("Connecting");
+    LogInfo::print("Connecting");
+    uint32_t start = millis();
     while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start > WIFI_CONNECT_TIMEOUT_MS) {
+            TRACE_END(TRACE_WIFI);
+            LogError::println(" WiFi connect timed out");
+            return false;
+        }
         delay(500);
-        Serial.print(".");
+        LogInfo::print(".");
     }
-    Serial.println();
-    Serial.println("WiFi connected");
-    Serial.println("IP address: ");
-    Serial.println(WiFi.localIP());
+    TRACE_END(TRACE_WIFI);
+    health.connected(millis() - start, WiFi.RSSI(), WiFi.channel());
+    LogInfo::println();
+    LogInfo::println("WiFi connected");
+    LogInfo::println("IP address: ");
+    LogInfo::println(WiFi.localIP());
     begun = true;
+    return true;
+}
+
+void Communication::end(void) {
+    if (begun) WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+    WiFi.forceSleepBegin();
+    delay(1);  // Lets the modem sleep take effect
+    begun = false;
 }
 
 time_t Communication::getNtpTime() {
@@ -133,7 +182,11 @@ time_t Communication::getNtpTime() {
     WiFiUDP udp;
     udp.begin(ntpLocalPort);
 
-    WiFi.hostByName(ntpServerName, timeServerIP);
+    bool cached = false;
+    if (!resolve(ntpServerName, timeServerIP, cached)) {
+        LogError::println("NTP server not found");
+        return 0;
+    }
     sendNTPpacket(timeServerIP, udp, packetBuffer);  // send an NTP packet to a time server
 
     delay(100);
@@ -144,7 +197,8 @@ time_t Communication::getNtpTime() {
         cb = udp.parsePacket();
     }
     if (!cb) {
-        Serial.println("no time received");
+        LogError::println("no time received");
+        if (cached) dnsCache.forget(ntpServerName);  // Pool servers come and go, look up another next time
         return 0;
     } else {
         // We've received a packet, read the data from it
@@ -160,20 +214,20 @@ time_t Communication::getNtpTime() {
         unsigned long secsSince1900 = highWord << 16 | lowWord;
 
         // now convert NTP time into everyday time:
-        Serial.print("Unix time = ");
+        LogDebug::print("Unix time = ");
         // Unix time starts on Jan 1 1970. In seconds, that's 2208988800:
         const unsigned long seventyYears = 2208988800UL;
         // subtract seventy years:
         unsigned long epoch = secsSince1900 - seventyYears;
         // print Unix time:
-        Serial.println(epoch);
+        LogDebug::println(epoch);
         return epoch;
     }
 }
 
 // send an NTP request to the time server at the given address
 void sendNTPpacket(IPAddress& address, WiFiUDP& udp, byte* packetBuffer) {
-    Serial.println("sending NTP packet...");
+    LogDebug::println("sending NTP packet...");
     // set all bytes in the buffer to 0
     memset(packetBuffer, 0, NTP_PACKET_SIZE);
     // Initialize values needed to form NTP request
@@ -196,6 +250,7 @@ void sendNTPpacket(IPAddress& address, WiFiUDP& udp, byte* packetBuffer) {
 }
 
 bool Communication::registerDevice(void) {
+    if (!settings.urlSet || !settings.registrationTokenSet) return false;
     char pageBuffer[65];
     StaticJsonDocument<256> doc;
     eepromStore.readPage((uint8_t*)pageBuffer, EEPROM_REGISTER_SECRET_PAGE);
@@ -204,23 +259,23 @@ bool Communication::registerDevice(void) {
     doc["token"] = secretString;
     String query;
     serializeJson(doc, query);
-    String result = jsonQuery("register", query);
-    Serial.print("Registration result: '");
-    Serial.print(result);
-    Serial.println("'");
+    String result = jsonQuery("register", query.c_str(), query.length());
+    LogDebug::print("Registration result: '");
+    LogDebug::print(result);
+    LogDebug::println("'");
     deserializeJson(doc, result);
     JsonObject obj = doc.as<JsonObject>();
     if (obj["status"] != "registered") {
-        Serial.println("Registration failed");
+        LogError::println("Registration failed");
         return false;
     }
     String tokenBase64 = obj["token"];
     if (tokenBase64 == NULL) {
-        Serial.println("No token received");
+        LogError::println("No token received");
         return false;
     }
     if (tokenBase64.length() > sizeof(registrationBase64)) {
-        Serial.println("Token too long");
+        LogError::println("Token too long");
         return false;
     }
     tokenBase64.toCharArray(registrationBase64, sizeof(registrationBase64));
@@ -228,50 +283,178 @@ bool Communication::registerDevice(void) {
     // Decode token
     int tokenLen = rbase64_decode(pageBuffer, registrationBase64, strlen(registrationBase64));
 
-    Serial.print("Decoded token len: ");
-    Serial.println(tokenLen);
+    LogDebug::print("Decoded token len: ");
+    LogDebug::println(tokenLen);
     pageBuffer[tokenLen] = 0x00;
 
     if (!checkCrcBuf((uint8_t*)pageBuffer, EEPROM_PAGESIZE)) {
-        Serial.println("Token CRC Failed");
+        LogError::println("Token CRC Failed");
         return false;
     }
 
-    Serial.println("Registration OK");
+    LogInfo::println("Registration OK");
     eepromStore.writePage((uint8_t*)pageBuffer, EEPROM_DEVICE_TOKEN_PAGE);
+    memcpy(deviceToken, pageBuffer, EEPROM_PAGESIZE);
+    tokenLoaded = true;
     settings.registered = true;
 
     return true;
 }
 
-String Communication::jsonQuery(String service, String query) {
-    if (port == 0) return "PORTMISSING";
+// The batching, signing and acknowledgement handling live in Uploader, WakeCycle runs it with this key.
+bool Communication::registrationNeeded(void) {
+    return !udp;
+}
+
+const uint8_t* Communication::signingKey(void) {
+    return tokenLoaded ? deviceToken : NULL;
+}
+
+bool Communication::binary(void) {
+    return udp;
+}
+
+bool Communication::post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) {
+    if (udp) return udpQuery(body, len, signature, reply);
+    String result = jsonQuery(service, body, len, signature);
+    // TLS vouches for the server, over plain http only a reply signed with the device token does.
+    if (!ssl && signature &&
+        !Uploader::checkReply(result.c_str(), result.length(), signature, replySignature.c_str(), deviceToken, sizeof(deviceToken))) {
+        LogError::print("Upload failed: unsigned reply '");
+        LogError::print(result);
+        LogError::println("'");
+        return false;
+    }
+    // The ack first and on its own, a config that does not parse must not fail the upload it came with.
+    StaticJsonDocument<JSON_OBJECT_SIZE(3)> filter;
+    filter["status"] = true;
+    filter["ack"] = true;
+    filter["cfgver"] = true;
+    StaticJsonDocument<UPLOAD_REPLY_SIZE> doc;
+    DeserializationError error = deserializeJson(doc, result, DeserializationOption::Filter(filter));
+    // A status message too long for the document is not "ok" either, the reply was still answered.
+    if (error && error != DeserializationError::NoMemory) {
+        LogError::print("Upload failed: '");
+        LogError::print(result);
+        LogError::println("'");
+        return false;
+    }
+    reply.ok = doc["status"] == "ok";
+    reply.hasAck = doc["ack"].is<uint32_t>();
+    if (reply.hasAck) reply.ack = doc["ack"].as<uint32_t>();
+    if (!reply.ok) {
+        LogError::print("Upload failed: '");
+        LogError::print(result);
+        LogError::println("'");
+        return true;
+    }
+    if (doc["cfgver"].is<uint32_t>() && doc["cfgver"].as<uint32_t>() != settings.store.configversion) {
+        if (applyConfig(result, doc["cfgver"].as<uint32_t>())) configApplied = true;
+    }
+    return true;
+}
+
+/* Remote config
+   Keys are the shell's set commands, values as there: si, sp, sn, sm, sr, sg, sl, so and sc take a number,
+   sd and sa an array of 4 (temperature, humidity, pressure, battery). Missing keys keep their value.
+   Nothing is applied if any value is out of range or the config does not fit CONFIG_SIZE, the upload goes on.
+*/
+static bool configValue(JsonVariantConst value, uint32_t low, uint32_t high, uint16_t& target) {
+    if (value.isNull()) return true;
+    if (!value.is<uint32_t>()) return false;
+    uint32_t v = value.as<uint32_t>();
+    if (v < low || v > high) return false;
+    target = v;
+    return true;
+}
+
+bool applyConfig(const String& reply, uint32_t version) {
+    // Only the keys below take room in the document.
+    StaticJsonDocument<CONFIG_FILTER_SIZE> filter;
+    const char* keys[CONFIG_KEYS] = {"si", "sp", "sn", "sm", "sr", "sg", "sl", "so", "sc", "sd", "sa"};
+    for (const char* key : keys) filter["config"][key] = true;
+    StaticJsonDocument<CONFIG_SIZE> doc;
+    DeserializationError error = deserializeJson(doc, reply, DeserializationOption::Filter(filter));
+    JsonObjectConst config = doc["config"];
+    if (error || config.isNull()) {
+        LogError::print("Skipped remote config: ");
+        LogError::println(error ? error.c_str() : "missing");
+        return false;
+    }
+    SettingsStorage updated = settings.store;
+    uint16_t aggregatemode = updated.aggregatemode;
+    uint16_t tempresolution = updated.tempresolution;
+    bool valid = configValue(config["si"], 1, 0xffff, updated.sampleinterval) &&
+                 configValue(config["sp"], 1, 0xffff, updated.uploadinterval) &&
+                 configValue(config["sn"], 1, 0xffff, updated.batchsize) &&
+                 configValue(config["sm"], 1, 0xffff, updated.maxstoreinterval) &&
+                 configValue(config["sr"], 1, 0xffff, updated.radiobudget) &&
+                 configValue(config["sg"], 0, 0xffff, updated.aggregatewindow) &&
+                 configValue(config["sl"], 0, 0xffff, updated.healthinterval) &&
+                 configValue(config["so"], AGGREGATE_WITH_RAW, AGGREGATE_ONLY, aggregatemode) &&
+                 configValue(config["sc"], 9, 12, tempresolution);
+    for (int g = 0; g < CHANNEL_GROUPS && valid; g++) {
+        valid = configValue(config["sd"][g], 0, 0xffff, updated.deadband[g]) &&
+                configValue(config["sa"][g], 0, 0xffff, updated.alarm[g]);
+    }
+    if (!valid || !updated.windowFits()) {
+        LogError::println("Rejected remote config");
+        return false;
+    }
+    updated.aggregatemode = aggregatemode;
+    updated.tempresolution = tempresolution;
+    updated.configversion = version;
+    settings.store = updated;
+    settings.save();  // New CRC and written to EEPROM
+    LogInfo::print("Applied remote config version ");
+    LogInfo::println(version);
+    return true;
+}
 
-    X509List cert(ISRG_Root_X1);
-    cert.append(DST_ROOT_CA_X3);
+String Communication::jsonQuery(String service, const char* query, size_t queryLen, const char* signature) {
+    replySignature = "";
+    if (port == 0) return "PORTMISSING";
 
-    WiFiClientSecure client;
-    client.setX509Time(Clock.getTime());
-    client.setTrustAnchors(&cert);
+    // Plain http skips the TLS handshake, uploads are still signed with the device token.
+    X509List cert;
+    WiFiClientSecure secureClient;
+    WiFiClient plainClient;
+    WiFiClient& client = ssl ? secureClient : plainClient;
+    if (ssl) {
+        cert.append(ISRG_Root_X1);
+        cert.append(DST_ROOT_CA_X3);
+        secureClient.setX509Time(Clock.getTime());
+        secureClient.setTrustAnchors(&cert);
+    }
     String url = baseUrl + "api/" + service + ".php";
-    if (!client.connect(server, port)) {
+    TRACE_BEGIN(TRACE_TLS);
+    uint32_t connectStart = millis();
+    // TLS connects by name, for SNI and the certificate name check.
+    if (!(ssl ? client.connect(server, port) : connectPlain(client))) {
+        TRACE_END(TRACE_TLS);
         return "Connection Failed";
     }
-
-    String queryLen = String(query.length());
+    TRACE_END(TRACE_TLS);
+    if (ssl) health.tlsDone(millis() - connectStart);
 
     client.print(String("POST ") + url + " HTTP/1.1\r\n" +
                  "Host: " + server + "\r\n" +
                  "User-Agent: Tempsens2.0\r\n" +
                  "Content-Type: application/json\r\n" +
-                 "Content-Length: " + queryLen + "\r\n" +
-                 "Connection: close\r\n\r\n" +
-                 query + "\r\n");
+                 (signature ? String("X-Signature: ") + signature + "\r\n" : String()) +
+                 "Content-Length: " + String(queryLen) + "\r\n" +
+                 "Connection: close\r\n\r\n");
+    client.write((const uint8_t*)query, queryLen);
+    client.print("\r\n");
     while (client.connected()) {
         String line = client.readStringUntil('\n');
         if (line == "\r") {
             break;
         }
+        if (line.substring(0, 12).equalsIgnoreCase("X-Signature:")) {
+            replySignature = line.substring(12);
+            replySignature.trim();
+        }
     }
     String line = client.readStringUntil('\n');
     line = client.readStringUntil('\n');
@@ -280,4 +463,80 @@ String Communication::jsonQuery(String service, String query) {
     return line;
 }
 
+// Sends a binary batch as one datagram and waits for its UploadAck, sending it again while none arrives.
+// The collector stores each record once, so a batch arriving twice is harmless.
+bool Communication::udpQuery(const char* body, size_t len, const char* signature, UploadReply& reply) {
+    if (port == 0) return false;
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    if (signature) {
+        for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+            char hex[3] = {signature[2 * i], signature[2 * i + 1], 0};
+            mac[i] = strtoul(hex, NULL, 16);
+        }
+    }
+    IPAddress address;
+    bool cached = false;
+    if (!resolve(server.c_str(), address, cached)) {
+        LogError::println("Upload failed: collector not found");
+        return false;
+    }
+    WiFiUDP udp;
+    udp.begin(UDP_LOCAL_PORT);
+    for (int attempt = 0; attempt <= UPLOAD_DATAGRAM_RETRIES; attempt++) {
+        udp.beginPacket(address, port);
+        udp.write((const uint8_t*)body, len);
+        if (signature) udp.write(mac, sizeof(mac));
+        if (!udp.endPacket()) {
+            LogError::println("UDP send failed");
+            break;
+        }
+        uint32_t sent = millis();
+        while (millis() - sent < UPLOAD_ACK_TIMEOUT_MS) {
+            uint8_t ack[sizeof(UploadAck) + 1];
+            if (udp.parsePacket() > 0) {
+                size_t ackLen = udp.read(ack, sizeof(ack));
+                if (Uploader::parseAck(ack, ackLen, body, tokenLoaded ? deviceToken : NULL, sizeof(deviceToken), reply)) {
+                    udp.stop();
+                    return true;
+                }
+            }
+            delay(1);
+        }
+        LogDebug::println("UDP ack timeout");
+    }
+    udp.stop();
+    LogError::println("Upload failed: no UDP ack");
+    if (cached) dnsCache.forget(server.c_str());  // Next attempt looks the collector up again
+    return false;
+}
+
+bool Communication::resolve(const char* name, IPAddress& address, bool& cached) {
+    uint32_t now = Clock.getTime();
+    uint32_t known = 0;
+    bool fresh = false;
+    cached = dnsCache.get(name, now, known, fresh);
+    if (cached && fresh) {
+        address = IPAddress(known);
+        return true;
+    }
+    if (WiFi.hostByName(name, address)) {
+        dnsCache.put(name, (uint32_t)address, now);
+        cached = false;
+        return true;
+    }
+    // Resolver unreachable, the old address may well still work.
+    if (cached) address = IPAddress(known);
+    return cached;
+}
+
+// Connects to the cached address of the server, and after a failure once more with a fresh lookup.
+bool Communication::connectPlain(WiFiClient& client) {
+    IPAddress address;
+    bool cached = false;
+    if (resolve(server.c_str(), address, cached) && client.connect(address, port)) return true;
+    if (!cached) return false;
+    dnsCache.forget(server.c_str());
+    return resolve(server.c_str(), address, cached) && client.connect(address, port);
+}
+
 Communication Comms;
@@ -0,0 +1,83 @@
+#include "dnscache.h"
+
+#include <Arduino.h>
+#include <CRC32.h>
+
+#include "rtcmem.h"
+#include "tools.h"
+
+static uint32_t nameHash(const char* name) {
+    uint32_t hash = CRC32::calculate((const uint8_t*)name, strlen(name));
+    return hash ? hash : 1;  // 0 marks unused entries
+}
+
+DnsCacheBuffer::DnsCacheBuffer() {}
+
+DnsCacheBuffer::~DnsCacheBuffer() {}
+
+DnsCache::DnsCache() {
+    hits = 0;
+    loaded = false;
+}
+
+DnsCache::~DnsCache() {}
+
+bool DnsCache::get(const char* name, uint32_t now, uint32_t& address, bool& fresh) {
+    load();
+    DnsCacheEntry* entry = find(nameHash(name));
+    if (!entry) return false;
+    address = entry->address;
+    fresh = now < entry->expires;
+    if (fresh) hits++;
+    return true;
+}
+
+void DnsCache::put(const char* name, uint32_t address, uint32_t now) {
+    load();
+    uint32_t hash = nameHash(name);
+    DnsCacheEntry* entry = find(hash);
+    for (int e = 0; e < DNS_CACHE_ENTRIES && !entry; e++) {
+        if (buffer.entries[e].name == 0) entry = &buffer.entries[e];
+    }
+    if (!entry) {
+        entry = &buffer.entries[0];
+        for (int e = 1; e < DNS_CACHE_ENTRIES; e++) {
+            if (buffer.entries[e].expires < entry->expires) entry = &buffer.entries[e];
+        }
+    }
+    entry->name = hash;
+    entry->address = address;
+    entry->expires = now + DNS_CACHE_TTL;
+    save();
+}
+
+void DnsCache::forget(const char* name) {
+    load();
+    DnsCacheEntry* entry = find(nameHash(name));
+    if (!entry) return;
+    entry->name = 0;
+    save();
+}
+
+void DnsCache::load(void) {
+    static_assert(sizeof(DnsCacheBuffer) % RTCMEM_BLOCKSIZE == 0, "DnsCacheBuffer must fill whole blocks.");
+    static_assert(RTCMEM_DNS_BLOCK + sizeof(DnsCacheBuffer) / RTCMEM_BLOCKSIZE <= RTCMEM_BLOCKS, "DnsCacheBuffer does not fit in RTC memory.");
+    if (loaded) return;
+    ESP.rtcUserMemoryRead(RTCMEM_DNS_BLOCK, (uint32_t*)&buffer, sizeof(buffer));
+    if (!checkCrcBuf((uint8_t*)&buffer, sizeof(buffer))) memset((uint8_t*)&buffer, 0, sizeof(buffer));
+    loaded = true;
+}
+
+void DnsCache::save(void) {
+    updateCrcBuf((uint8_t*)&buffer, sizeof(buffer));
+    ESP.rtcUserMemoryWrite(RTCMEM_DNS_BLOCK, (uint32_t*)&buffer, sizeof(buffer));
+}
+
+DnsCacheEntry* DnsCache::find(uint32_t name) {
+    for (int e = 0; e < DNS_CACHE_ENTRIES; e++) {
+        if (buffer.entries[e].name == name) return &buffer.entries[e];
+    }
+    return NULL;
+}
+
+DnsCache dnsCache;
@@ -3,7 +3,9 @@
 #include <Adafruit_MCP23017.h>
 #include <SPI.h>
 
+#include "log.h"
 #include "pinout.h"
+#include "rtcc.h"
 
 #define EEPROM_CMD_READ 0b00000011
 #define EEPROM_CMD_WRITE 0b00000010
@@ -15,8 +17,10 @@
 extern Adafruit_MCP23017 ioexpander;
 
 EEPromStore::EEPromStore() {
-    
+    static_assert(sizeof(RTCCmem::eepromMHz) == EEPROM_MAX_CHIPS, "RTCCmem::eepromMHz has wrong size.");
     this->maxPages = EEPROM_PAGESPERCHIP; // Before settings are loaded assume that we have ONE chip
+    pageWrites = 0;
+    writeRetries = 0;
 }
 
 EEPromStore::~EEPromStore() {
@@ -24,47 +28,47 @@ EEPromStore::~EEPromStore() {
 
 bool EEPromStore::readPage(uint8_t* buf, uint32_t pageNo) {
     if (pageNo >= this->maxPages) return false;
-    uint8_t chipPin = getChipPin(pageNo);
+    SPI.beginTransaction(SPISettings(getClockHz(pageNo), MSBFIRST, SPI_MODE0));
+    readRun(buf, pageNo, 1);
+    SPI.endTransaction();
+    return true;
+}
 
-    SPI.beginTransaction(SPISettings(14000000, MSBFIRST, SPI_MODE0));
-    waitForIdle(chipPin);
+bool EEPromStore::readPages(uint8_t* buf, uint32_t firstPage, uint32_t count) {
+    if (firstPage + count > this->maxPages) return false;
 
-    ioexpander.digitalWrite(chipPin, LOW);
-    SPI.transfer(EEPROM_CMD_READ);
-    SPI.transfer16(getPageStart(pageNo));
-    for (int c = 0; c < EEPROM_PAGESIZE; c++) {
-        buf[c] = SPI.transfer(0x00);
-    }
-    ioexpander.digitalWrite(chipPin, HIGH);
+    while (count > 0) {
+        // A read runs on through the chip, only a chip boundary needs a new command.
+        uint32_t run = EEPROM_PAGESPERCHIP - firstPage % EEPROM_PAGESPERCHIP;
+        if (run > count) run = count;
 
-    SPI.endTransaction();
+        SPI.beginTransaction(SPISettings(getClockHz(firstPage), MSBFIRST, SPI_MODE0));
+        readRun(buf, firstPage, run);
+        SPI.endTransaction();
+
+        buf += run * EEPROM_PAGESIZE;
+        firstPage += run;
+        count -= run;
+    }
     return true;
 }
 
 bool EEPromStore::writePage(uint8_t* buf, uint32_t pageNo) {
     if (pageNo >= this->maxPages) return false;
-    uint8_t chipPin = getChipPin(pageNo);
-
-    SPI.beginTransaction(SPISettings(14000000, MSBFIRST, SPI_MODE0));
-    waitForIdle(chipPin);
-    setWrite(chipPin);
-    ioexpander.digitalWrite(chipPin, LOW);
-    SPI.transfer(EEPROM_CMD_WRITE);
-    SPI.transfer16(getPageStart(pageNo));
-    for (int c = 0; c < EEPROM_PAGESIZE; c++) {
-        SPI.transfer(buf[c]);
-    }
-    ioexpander.digitalWrite(chipPin, HIGH);
-
-    waitForIdle(chipPin);
+    SPI.beginTransaction(SPISettings(getClockHz(pageNo), MSBFIRST, SPI_MODE0));
+    bool written = writeRun(buf, pageNo);
     SPI.endTransaction();
-    return true;
+    return written;
 }
 
 void EEPromStore::updateMaxPages(uint32_t maxPages) {
     this->maxPages = maxPages;
 }
 
+uint32_t EEPromStore::getMaxPages(void) {
+    return maxPages;
+}
+
 uint8_t EEPromStore::getChipPin(uint32_t pageNo) {
     int basePin = pageNo / EEPROM_PAGESPERCHIP;
     switch (basePin) {
@@ -88,6 +92,105 @@ uint16_t EEPromStore::getPageStart(uint32_t pageNo) {
     return (pageNo % EEPROM_PAGESPERCHIP) * EEPROM_PAGESIZE;
 }
 
+void EEPromStore::setClock(uint8_t mhz) {
+    if (mhz == 0) mhz = EEPROM_SPI_DEFAULT_MHZ;
+    uint8_t current = Clock.store.eepromMHzRequested ? Clock.store.eepromMHzRequested : EEPROM_SPI_DEFAULT_MHZ;
+    if (mhz == current) return;
+    Clock.store.eepromMHzRequested = mhz;
+    memset(Clock.store.eepromMHz, 0, sizeof(Clock.store.eepromMHz));
+    Clock.saveStore();
+}
+
+uint8_t EEPromStore::getClock(uint8_t chip) {
+    if (chip >= EEPROM_MAX_CHIPS) return EEPROM_SPI_SAFE_MHZ;
+    if (Clock.store.eepromMHz[chip] == 0) {
+        Clock.store.eepromMHz[chip] = verifyClock(chip);
+        Clock.saveStore();
+    }
+    return Clock.store.eepromMHz[chip];
+}
+
+uint32_t EEPromStore::getClockHz(uint32_t pageNo) {
+    return getClock(pageNo / EEPROM_PAGESPERCHIP) * 1000000UL;
+}
+
+// Highest clock up to the requested one at which the first page of the chip reads the same as at EEPROM_SPI_SAFE_MHZ.
+// A page with all bytes the same, as on a blank chip, can not tell clocks apart. A test pattern is written to it
+// at the safe clock for the check and the page is put back afterwards.
+uint8_t EEPromStore::verifyClock(uint8_t chip) {
+    uint8_t mhz = Clock.store.eepromMHzRequested ? Clock.store.eepromMHzRequested : EEPROM_SPI_DEFAULT_MHZ;
+    uint32_t page = chip * EEPROM_PAGESPERCHIP;
+    uint8_t reference[EEPROM_PAGESIZE];
+    uint8_t original[EEPROM_PAGESIZE];
+    uint8_t check[EEPROM_PAGESIZE];
+
+    SPI.beginTransaction(SPISettings(EEPROM_SPI_SAFE_MHZ * 1000000UL, MSBFIRST, SPI_MODE0));
+    readRun(reference, page, 1);
+    bool uniform = true;
+    for (int i = 1; i < EEPROM_PAGESIZE && uniform; i++) uniform = reference[i] == reference[0];
+    bool patterned = false;
+    if (uniform) {
+        memcpy(original, reference, sizeof(original));
+        // Alternating bits with a byte counter mixed in, so shifted or stuck bits show up.
+        for (int i = 0; i < EEPROM_PAGESIZE; i++) reference[i] = (i & 1 ? 0xaa : 0x55) ^ i;
+        patterned = writeRun(reference, page);
+        if (!patterned) memcpy(reference, original, sizeof(reference));
+    }
+    SPI.endTransaction();
+    for (; mhz > EEPROM_SPI_SAFE_MHZ; mhz /= 2) {
+        SPI.beginTransaction(SPISettings(mhz * 1000000UL, MSBFIRST, SPI_MODE0));
+        readRun(check, page, 1);
+        SPI.endTransaction();
+        if (memcmp(reference, check, sizeof(check)) == 0) break;
+        LogError::print("EEPROM ");
+        LogError::print(chip);
+        LogError::print(" failed at MHz ");
+        LogError::println(mhz);
+    }
+    if (patterned) {
+        SPI.beginTransaction(SPISettings(EEPROM_SPI_SAFE_MHZ * 1000000UL, MSBFIRST, SPI_MODE0));
+        writeRun(original, page);
+        SPI.endTransaction();
+    }
+    if (mhz < EEPROM_SPI_SAFE_MHZ) mhz = EEPROM_SPI_SAFE_MHZ;
+    LogDebug::print("EEPROM ");
+    LogDebug::print(chip);
+    LogDebug::print(" SPI MHz: ");
+    LogDebug::println(mhz);
+    return mhz;
+}
+
+// Reads count pages within one chip, the transaction has to be open.
+void EEPromStore::readRun(uint8_t* buf, uint32_t firstPage, uint32_t count) {
+    uint8_t chipPin = getChipPin(firstPage);
+    uint8_t header[3] = {EEPROM_CMD_READ, (uint8_t)(getPageStart(firstPage) >> 8), (uint8_t)getPageStart(firstPage)};
+
+    waitForIdle(chipPin);
+    ioexpander.digitalWrite(chipPin, LOW);
+    SPI.writeBytes(header, sizeof(header));
+    // Whole FIFO loads instead of a driver call per byte.
+    SPI.transferBytes(NULL, buf, count * EEPROM_PAGESIZE);
+    ioexpander.digitalWrite(chipPin, HIGH);
+}
+
+// Writes one page and waits for the write cycle to end, the transaction has to be open.
+bool EEPromStore::writeRun(uint8_t* buf, uint32_t pageNo) {
+    uint8_t chipPin = getChipPin(pageNo);
+    uint8_t header[3] = {EEPROM_CMD_WRITE, (uint8_t)(getPageStart(pageNo) >> 8), (uint8_t)getPageStart(pageNo)};
+
+    waitForIdle(chipPin);
+    if (!setWrite(chipPin)) return false;
+    // A page fills the 64 byte SPI FIFO, so it goes out in one driver call.
+    ioexpander.digitalWrite(chipPin, LOW);
+    SPI.writeBytes(header, sizeof(header));
+    SPI.writeBytes(buf, EEPROM_PAGESIZE);
+    ioexpander.digitalWrite(chipPin, HIGH);
+    pageWrites++;
+
+    waitForIdle(chipPin);
+    return true;
+}
+
 void EEPromStore::waitForIdle(uint8_t chipPin) {
     uint8_t status = readStatus(chipPin);
     while (status & 0x01) {
@@ -109,18 +212,19 @@ uint8_t EEPromStore::readStatus(uint8_t chipPin) {
 
     return status;
 }
-void EEPromStore::setWrite(uint8_t chipPin) {
-    ioexpander.digitalWrite(chipPin, LOW);
-    SPI.transfer(EEPROM_CMD_WREN);
-    ioexpander.digitalWrite(chipPin, HIGH);
-    uint8_t status = readStatus(chipPin);
-    while (!status & 0x01) {
-        delay(10);
+bool EEPromStore::setWrite(uint8_t chipPin) {
+    for (int attempt = 0; attempt < EEPROM_WREN_RETRIES; attempt++) {
+        if (attempt > 0) {
+            writeRetries++;
+            delay(10);
+        }
         ioexpander.digitalWrite(chipPin, LOW);
         SPI.transfer(EEPROM_CMD_WREN);
         ioexpander.digitalWrite(chipPin, HIGH);
-        status = readStatus(chipPin);
+        if (readStatus(chipPin) & 0x02) return true;  // Write enable latch set
     }
+    LogError::println("EEPROM write enable failed");
+    return false;
 }
 
 void EEPromStore::clearWrite(uint8_t chipPin) {
@@ -0,0 +1,74 @@
+#include "energy.h"
+
+#include "acquisition.h"
+#include "eepromstore.h"
+
+static const char* stateNames[ENERGY_STATES] = {"CPU", "Radio", "EEPROM", "Sensors", "Sleep"};
+
+EnergyModel::EnergyModel() {
+    currentmA[ENERGY_CPU] = ENERGY_CPU_MA;
+    currentmA[ENERGY_RADIO] = ENERGY_RADIO_MA;
+    currentmA[ENERGY_EEPROM] = ENERGY_EEPROM_MA;
+    currentmA[ENERGY_SENSOR] = ENERGY_SENSOR_MA;
+    currentmA[ENERGY_SLEEP] = ENERGY_SLEEP_MA;
+    for (int s = 0; s < ENERGY_STATES; s++) us[s] = 0;
+    lastPageWrites = 0;
+}
+
+EnergyModel::~EnergyModel() {}
+
+void EnergyModel::reset(void) {
+    for (int s = 0; s < ENERGY_STATES; s++) us[s] = 0;
+    lastPageWrites = eepromStore.pageWrites;
+}
+
+void EnergyModel::setCurrent(ENERGY_STATE state, float mA) {
+    currentmA[state] = mA;
+}
+
+float EnergyModel::current(ENERGY_STATE state) {
+    return currentmA[state];
+}
+
+void EnergyModel::add(ENERGY_STATE state, uint64_t us) {
+    this->us[state] += us;
+}
+
+void EnergyModel::addWake(uint64_t awakeUs, uint32_t radioMs) {
+    add(ENERGY_CPU, awakeUs);
+    add(ENERGY_RADIO, (uint64_t)radioMs * 1000);
+    for (int t = 0; t < ACQUISITION_MAX_TASKS; t++) {
+        if (acquisition.timing.done[t] > acquisition.timing.started[t]) {
+            add(ENERGY_SENSOR, acquisition.timing.done[t] - acquisition.timing.started[t]);
+        }
+    }
+    add(ENERGY_EEPROM, (uint64_t)(eepromStore.pageWrites - lastPageWrites) * ENERGY_EEPROM_WRITE_US);
+    lastPageWrites = eepromStore.pageWrites;
+}
+
+const char* EnergyModel::name(ENERGY_STATE state) {
+    return state < ENERGY_STATES ? stateNames[state] : "?";
+}
+
+float EnergyModel::mAh(ENERGY_STATE state) {
+    return currentmA[state] * (us[state] / 3600e6);
+}
+
+float EnergyModel::mAhTotal(void) {
+    float total = 0;
+    for (int s = 0; s < ENERGY_STATES; s++) total += mAh((ENERGY_STATE)s);
+    return total;
+}
+
+float EnergyModel::mAhPerDay(void) {
+    uint64_t elapsed = us[ENERGY_CPU] + us[ENERGY_SLEEP];
+    if (elapsed == 0) return 0;
+    return mAhTotal() * (86400e6 / elapsed);
+}
+
+float EnergyModel::batteryDays(float capacitymAh) {
+    float perDay = mAhPerDay();
+    return perDay > 0 ? capacitymAh / perDay : 0;
+}
+
+EnergyModel energy;
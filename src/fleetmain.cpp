@@ -0,0 +1,518 @@
+#if defined(FLEET) && !defined(PIO_UNIT_TESTING)
+// Fleet simulator for the fleet env, takes the place of main.cpp.
+// Forks one process per device, each runs the sample, register and upload cycle of the firmware in virtual time
+// against a server on the host (tools/ingestserver.py), paced so many devices load the server at once.
+// Reports requests per second, payload bytes and latency as seen by the devices.
+#include <Adafruit_MCP23017.h>
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <hostsim.h>
+#include <netinet/in.h>
+#include <simeeprom.h>
+#include <simrtcc.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "acquisition.h"
+#include "aggregator.h"
+#include "battery.h"
+#include "eepromstore.h"
+#include "health.h"
+#include "hmac.h"
+#include "log.h"
+#include "pinout.h"
+#include "rtcc.h"
+#include "settings.h"
+#include "tools.h"
+#include "trace.h"
+#include "uploader.h"
+#include "wakecycle.h"
+
+#define FLEET_START_TIME 1609459200  // 2021-01-01 00:00:00 UTC
+#define FLEET_BATTERY_ADC 640        // About 3.6V through the divider
+#define FLEET_CONNECT_MS 2000        // Virtual time for joining WiFi
+#define FLEET_WIFI_CHANNEL 6
+#define FLEET_WIFI_TIMEOUT_MS 15000  // As WIFI_CONNECT_TIMEOUT_MS, spent when the network is down
+#define FLEET_HTTP_TIMEOUT_S 10
+
+Adafruit_MCP23017 ioexpander;
+
+static SimEEPROM eeprom0;
+static SimRTCC rtcc;
+
+struct FleetOptions {
+    uint32_t devices = 10;
+    uint32_t days = 1;
+    double speedup = 3600;  // Virtual seconds per real second
+    uint16_t interval = 60;
+    uint16_t uploadInterval = SETTINGS_DEFAULT_UPLOADINTERVAL;
+    uint16_t batch = SETTINGS_DEFAULT_BATCHSIZE;
+    uint32_t skew = 0;           // Clocks are off by up to this many seconds either way
+    uint32_t outagePeriod = 0;   // Hours, the network is down for the last outageLength hours of every period
+    uint32_t outageLength = 0;
+    const char* host = "127.0.0.1";
+    uint16_t port = 8080;
+    const char* secret = "fleet";
+    uint16_t udpPort = 0;  // Upload datagrams to this collector port instead of HTTP
+    bool registration = true;
+    unsigned int seed = 1;
+};
+
+// Per device counters, written to the parent through a temporary file
+struct DeviceStats {
+    uint32_t requests;
+    uint32_t unanswered;  // Connection failed or no parsable reply
+    uint32_t rejected;    // Answered with a failed status
+    uint32_t badSignatures;  // Replies to signed requests without a valid signature, ignored
+    uint32_t registrations;
+    uint32_t attempts;
+    uint32_t outages;  // Attempts that found the network down
+    uint64_t bodyBytes;
+    uint64_t replyBytes;
+    uint32_t stored;
+    uint32_t acked;
+};
+
+static FleetOptions options;
+static DeviceStats stats;
+static std::vector<uint32_t> latencies;  // Microseconds per request
+static uint8_t deviceToken[EEPROM_PAGESIZE];  // Handed out at registration, the signing key
+
+// Unique valid serial number for device n: odd parity in the outer bytes, even in the middle two.
+static uint32_t fleetSerial(uint32_t n) {
+    uint8_t low = n & 0x7f;
+    uint8_t high = (n >> 7) & 0x7f;
+    low |= (__builtin_popcount(low) & 1) << 7;
+    high |= (__builtin_popcount(high) & 1) << 7;
+    return 0x80000001 | (uint32_t)high << 16 | (uint32_t)low << 8;
+}
+
+// Returns the value of key in a flat JSON object, enough for the replies of the stand-in server.
+static const char* jsonValue(const char* json, const char* key) {
+    std::string quoted = std::string("\"") + key + "\"";
+    const char* p = strstr(json, quoted.c_str());
+    if (!p) return NULL;
+    p += quoted.length();
+    while (*p == ' ' || *p == ':') p++;
+    return p;
+}
+
+static size_t base64Decode(const char* in, uint8_t* out, size_t outSize) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t bits = 0;
+    int count = 0;
+    size_t len = 0;
+    for (; *in && *in != '"' && *in != '='; in++) {
+        const char* c = strchr(alphabet, *in);
+        if (!c) return 0;
+        bits = bits << 6 | (c - alphabet);
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            if (len == outSize) return 0;
+            out[len++] = bits >> count;
+        }
+    }
+    return len;
+}
+
+// Plain HTTP the way Communication::jsonQuery sends it, over host sockets.
+class HttpTransport : public UploadTransport {
+   public:
+    // Sends one request and returns the JSON line of the reply, empty on failure. The reply's X-Signature
+    // ends up in replySignature.
+    std::string exchange(const char* service, const char* body, size_t len, const char* signature) {
+        replySignature.clear();
+        auto start = std::chrono::steady_clock::now();
+        stats.requests++;
+        stats.bodyBytes += len;
+        std::string line;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct timeval timeout = {FLEET_HTTP_TIMEOUT_S, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options.port);
+        inet_pton(AF_INET, options.host, &addr.sin_addr);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            char header[256];
+            snprintf(header, sizeof(header),
+                     "POST /api/%s.php HTTP/1.1\r\nHost: %s\r\nUser-Agent: Tempsens2.0\r\n"
+                     "Content-Type: application/json\r\n%s%s%sContent-Length: %u\r\nConnection: close\r\n\r\n",
+                     service, options.host, signature ? "X-Signature: " : "", signature ? signature : "",
+                     signature ? "\r\n" : "", (unsigned)len);
+            std::string request = std::string(header) + std::string(body, len) + "\r\n";
+            std::string response;
+            if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size()) {
+                char buf[1024];
+                ssize_t got;
+                while ((got = recv(fd, buf, sizeof(buf), 0)) > 0) response.append(buf, got);
+            }
+            stats.replyBytes += response.size();
+            // Like the device: skip the headers and the chunk size line, the JSON is on the next one.
+            size_t pos = response.find("\r\n\r\n");
+            size_t field = response.find("\r\nX-Signature: ");
+            if (field < pos) replySignature = response.substr(field + 15, response.find('\r', field + 15) - field - 15);
+            if (pos != std::string::npos) pos = response.find('\n', pos + 4);
+            if (pos != std::string::npos) {
+                line = response.substr(pos + 1, response.find('\n', pos + 1) - pos - 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+            }
+        }
+        close(fd);
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        latencies.push_back(us);
+        simAdvance(us);  // The radio stays on while waiting
+        if (line.empty()) stats.unanswered++;
+        return line;
+    }
+
+    bool post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) override {
+        std::string line = exchange(service, body, len, signature);
+        if (line.empty()) return false;
+        // As Communication::post on plain http
+        if (signature && !Uploader::checkReply(line.data(), line.size(), signature, replySignature.c_str(), deviceToken,
+                                               EEPROM_PAGESIZE)) {
+            stats.badSignatures++;
+            return false;
+        }
+        const char* status = jsonValue(line.c_str(), "status");
+        const char* ack = jsonValue(line.c_str(), "ack");
+        reply.ok = status && strncmp(status, "\"ok\"", 4) == 0;
+        reply.hasAck = ack && *ack >= '0' && *ack <= '9';
+        if (reply.hasAck) reply.ack = strtoul(ack, NULL, 10);
+        if (!reply.ok) stats.rejected++;
+        return true;
+    }
+
+    std::string replySignature;
+};
+
+// Binary batches as datagrams the way Communication::udpQuery sends them, over host sockets.
+class UdpTransport : public UploadTransport {
+   public:
+    bool binary(void) override { return true; }
+
+    bool post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) override {
+        auto start = std::chrono::steady_clock::now();
+        std::string datagram(body, len);
+        if (signature) {
+            for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+                char hex[3] = {signature[2 * i], signature[2 * i + 1], 0};
+                datagram += (char)strtoul(hex, NULL, 16);
+            }
+        }
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct timeval timeout = {0, UPLOAD_ACK_TIMEOUT_MS * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options.udpPort);
+        inet_pton(AF_INET, options.host, &addr.sin_addr);
+        bool answered = false;
+        for (int attempt = 0; attempt <= UPLOAD_DATAGRAM_RETRIES && !answered; attempt++) {
+            stats.requests++;
+            stats.bodyBytes += datagram.size();
+            sendto(fd, datagram.data(), datagram.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+            auto sent = std::chrono::steady_clock::now();
+            uint8_t ack[sizeof(UploadAck) + 1];
+            ssize_t got;
+            // Acks for earlier sends of the same batch are as good as this one's, others are skipped.
+            while (!answered && (got = recv(fd, ack, sizeof(ack), 0)) >= 0) {
+                stats.replyBytes += got;
+                answered = Uploader::parseAck(ack, got, body, signature ? deviceToken : NULL, sizeof(deviceToken), reply);
+                if (std::chrono::steady_clock::now() - sent > std::chrono::milliseconds(UPLOAD_ACK_TIMEOUT_MS)) break;
+            }
+            if (!answered) simAdvance(UPLOAD_ACK_TIMEOUT_MS * 1000ULL);
+        }
+        close(fd);
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        latencies.push_back(us);
+        simAdvance(us);
+        if (!answered) stats.unanswered++;
+        else if (!reply.ok) stats.rejected++;
+        return answered;
+    }
+};
+
+static HttpTransport transport;
+static UdpTransport datagrams;
+
+// Same request and token handling as Communication::registerDevice
+static bool registerWithServer(void) {
+    char body[128];
+    snprintf(body, sizeof(body), "{\"serial\":%u,\"token\":\"%s\"}", settings.store.serialno, options.secret);
+    std::string line = transport.exchange("register", body, strlen(body), NULL);
+    const char* status = jsonValue(line.c_str(), "status");
+    const char* token = jsonValue(line.c_str(), "token");
+    if (!status || strncmp(status, "\"registered\"", 12) != 0 || !token || *token != '"') {
+        LogError::println("Registration failed");
+        return false;
+    }
+    uint8_t page[EEPROM_PAGESIZE];
+    if (base64Decode(token + 1, page, sizeof(page)) != sizeof(page) || !checkCrcBuf(page, sizeof(page))) {
+        LogError::println("Token CRC Failed");
+        return false;
+    }
+    eepromStore.writePage(page, EEPROM_DEVICE_TOKEN_PAGE);
+    memcpy(deviceToken, page, EEPROM_PAGESIZE);
+    settings.registered = true;
+    stats.registrations++;
+    return true;
+}
+
+static bool networkDown(void) {
+    if (options.outagePeriod == 0) return false;
+    uint64_t hour = simMicros() / 3600000000ULL;
+    return hour % options.outagePeriod >= options.outagePeriod - options.outageLength;
+}
+
+// Random readings around fixed values, the fleet is about load on the server rather than the data.
+class FleetSensors : public SensorTask {
+   public:
+    bool start(void) override { return true; }
+    bool poll(void) override { return true; }
+    void read(Measurement& m) override {
+        m.barotemp = 21.0 + (rand() % 101 - 50) / 100.0;
+        m.tempsens0 = 4.0 + (rand() % 101 - 50) / 100.0;
+    }
+};
+
+// WiFi with the scheduled outages, uploads over HTTP or datagrams, the network time is the undrifted clock.
+class FleetRadio : public Radio {
+   public:
+    bool binary(void) override { return options.udpPort != 0; }
+    bool begin(void) override {
+        stats.attempts++;
+        if (networkDown()) {
+            delay(FLEET_WIFI_TIMEOUT_MS);
+            stats.outages++;
+            return false;
+        }
+        delay(FLEET_CONNECT_MS);
+        health.connected(FLEET_CONNECT_MS, -50 - rand() % 40, FLEET_WIFI_CHANNEL);  // -50 to -89 dBm
+        return true;
+    }
+    void end(void) override {}
+    bool registrationNeeded(void) override { return options.registration; }
+    bool registerDevice(void) override { return registerWithServer(); }
+    const uint8_t* signingKey(void) override { return settings.registered ? deviceToken : NULL; }
+    time_t getNtpTime(void) override { return FLEET_START_TIME + simMicros() / 1000000; }
+    bool post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) override {
+        if (options.udpPort) return datagrams.post(service, body, len, signature, reply);
+        return transport.post(service, body, len, signature, reply);
+    }
+};
+
+static FleetSensors fleetSensors;
+static FleetRadio radio;
+
+static void boot(uint32_t n) {
+    TRACE_WAKE();
+    Serial.begin(115200);
+    Clock.begin();
+
+    ioexpander.begin();
+    ioexpander.digitalWrite(IOEXP_EEPROM0, HIGH);
+    ioexpander.pinMode(IOEXP_EEPROM0, OUTPUT);
+    ioexpander.pinMode(IOEXP_EXTPOWR, INPUT);
+
+    // Provisioned as with the shell: serial, intervals, upload URL and registration secret.
+    settings.store.serialno = fleetSerial(n);
+    settings.store.sampleinterval = options.interval;
+    settings.store.uploadinterval = options.uploadInterval;
+    settings.store.batchsize = options.batch;
+    settings.save();
+    char page[EEPROM_PAGESIZE] = {};
+    snprintf(page, sizeof(page), "http://%s:%u/", options.host, options.port);
+    eepromStore.writePage((uint8_t*)page, EEPROM_URL_PAGE);
+    memset(page, 0, sizeof(page));
+    strncpy(page, options.secret, sizeof(page) - 1);
+    eepromStore.writePage((uint8_t*)page, EEPROM_REGISTER_SECRET_PAGE);
+    settings.urlSet = true;
+    settings.registrationTokenSet = true;
+
+    acquisition.add(&battery, "Battery");
+    acquisition.add(&fleetSensors, "Fleet");
+    aggregator.begin();
+}
+
+static void runDevice(uint32_t n, std::chrono::steady_clock::time_point realStart, const char* resultPath) {
+    srand(options.seed * 7919 + n);
+    simAttachSpiDevice(&eeprom0, IOEXP_EEPROM0);
+    simAttachI2CDevice(&rtcc, SIMRTCC_ADDRESS);
+    simSetAnalog(FLEET_BATTERY_ADC);
+    int32_t skew = options.skew ? (int32_t)(rand() % (2 * options.skew + 1)) - (int32_t)options.skew : 0;
+    rtcc.start(FLEET_START_TIME + skew);
+    delay((rand() % options.interval) * 1000UL);  // Devices were not all switched on at the same second
+
+    boot(n);
+    uint64_t end = (uint64_t)options.days * 86400 * 1000000;
+    while (simMicros() < end) {
+        wakeCycle.run(radio);
+        delay(settings.store.sampleinterval * 1000UL);
+
+        auto due = realStart + std::chrono::microseconds((uint64_t)(simMicros() / options.speedup));
+        std::this_thread::sleep_until(due);
+    }
+
+    stats.stored = Clock.store.nextId;
+    stats.acked = Clock.store.lastSentId;
+    FILE* out = fopen(resultPath, "wb");
+    if (!out) return;
+    fwrite(&stats, sizeof(stats), 1, out);
+    uint32_t count = latencies.size();
+    fwrite(&count, sizeof(count), 1, out);
+    fwrite(latencies.data(), sizeof(uint32_t), count, out);
+    fclose(out);
+}
+
+static double percentile(std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))] / 1000.0;
+}
+
+static void usage(void) {
+    printf("fleet [--devices n] [--days d] [--speedup x] [--interval s] [--upload-interval min] [--batch n]\n"
+           "      [--skew s] [--outage period:length] [--host ip] [--port n] [--secret s] [--seed n]\n"
+           "      [--udp-port n] [--register 0|1]\n"
+           "Outage period and length are hours, the network is down for the last length hours of every period.\n"
+           "--udp-port uploads datagrams to a collector (tools/udpcollector.py), registration still goes to --port\n"
+           "unless --register 0, unregistered devices send unsigned batches.\n");
+}
+
+int main(int argc, char** argv) {
+    for (int a = 1; a < argc; a++) {
+        const char* arg = argv[a];
+        const char* value = a + 1 < argc ? argv[a + 1] : NULL;
+        if (!value) {
+            usage();
+            return 1;
+        }
+        a++;
+        if (strcmp(arg, "--devices") == 0) {
+            options.devices = atoi(value);
+        } else if (strcmp(arg, "--days") == 0) {
+            options.days = atoi(value);
+        } else if (strcmp(arg, "--speedup") == 0) {
+            options.speedup = atof(value);
+        } else if (strcmp(arg, "--interval") == 0) {
+            options.interval = atoi(value);
+        } else if (strcmp(arg, "--upload-interval") == 0) {
+            options.uploadInterval = atoi(value);
+        } else if (strcmp(arg, "--batch") == 0) {
+            options.batch = atoi(value);
+        } else if (strcmp(arg, "--skew") == 0) {
+            options.skew = atoi(value);
+        } else if (strcmp(arg, "--outage") == 0) {
+            if (sscanf(value, "%u:%u", &options.outagePeriod, &options.outageLength) != 2 ||
+                options.outageLength >= options.outagePeriod) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(arg, "--host") == 0) {
+            options.host = value;
+        } else if (strcmp(arg, "--port") == 0) {
+            options.port = atoi(value);
+        } else if (strcmp(arg, "--secret") == 0) {
+            options.secret = value;
+        } else if (strcmp(arg, "--udp-port") == 0) {
+            options.udpPort = atoi(value);
+        } else if (strcmp(arg, "--register") == 0) {
+            options.registration = atoi(value) != 0;
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = atoi(value);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (options.devices == 0 || options.devices > 16384 || options.interval == 0 || options.speedup <= 0) {
+        usage();
+        return 1;
+    }
+
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    // Each device writes its counters and latencies to a file of its own.
+    char resultDir[] = "/tmp/fleetXXXXXX";
+    if (!mkdtemp(resultDir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::vector<pid_t> children;
+    auto realStart = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < options.devices; n++) {
+        std::string path = std::string(resultDir) + "/" + std::to_string(n);
+        pid_t pid = fork();
+        if (pid == 0) {
+            runDevice(n, realStart, path.c_str());
+            _exit(0);
+        }
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children) waitpid(pid, NULL, 0);
+    double realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - realStart).count();
+
+    DeviceStats total = {};
+    std::vector<uint32_t> all;
+    uint32_t reported = 0;
+    for (uint32_t n = 0; n < children.size(); n++) {
+        std::string path = std::string(resultDir) + "/" + std::to_string(n);
+        FILE* in = fopen(path.c_str(), "rb");
+        if (!in) continue;
+        DeviceStats s;
+        uint32_t count;
+        bool valid = fread(&s, sizeof(s), 1, in) == 1 && fread(&count, sizeof(count), 1, in) == 1;
+        if (valid) {
+            size_t first = all.size();
+            all.resize(first + count);
+            all.resize(first + fread(all.data() + first, sizeof(uint32_t), count, in));
+        }
+        fclose(in);
+        unlink(path.c_str());
+        if (!valid) continue;
+        total.requests += s.requests;
+        total.unanswered += s.unanswered;
+        total.rejected += s.rejected;
+        total.badSignatures += s.badSignatures;
+        total.registrations += s.registrations;
+        total.attempts += s.attempts;
+        total.outages += s.outages;
+        total.bodyBytes += s.bodyBytes;
+        total.replyBytes += s.replyBytes;
+        total.stored += s.stored;
+        total.acked += s.acked;
+        reported++;
+    }
+    rmdir(resultDir);
+    std::sort(all.begin(), all.end());
+
+    printf("Fleet of %u device(s), %u reported, %u day(s) in %.1f s\n", options.devices, reported, options.days, realSeconds);
+    printf("  Requests:        %u (%.1f/s), %u unanswered, %u rejected, %u with a bad reply signature\n", total.requests,
+           total.requests / realSeconds, total.unanswered, total.rejected, total.badSignatures);
+    printf("  Registrations:   %u\n", total.registrations);
+    printf("  Upload attempts: %u, %u during outages\n", total.attempts, total.outages);
+    printf("  Body bytes:      %llu (%.0f per request, %.0f/s)\n", (unsigned long long)total.bodyBytes,
+           total.requests ? (double)total.bodyBytes / total.requests : 0.0, total.bodyBytes / realSeconds);
+    printf("  Reply bytes:     %llu\n", (unsigned long long)total.replyBytes);
+    printf("  Latency ms:      p50 %.2f, p95 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n", percentile(all, 0.5),
+           percentile(all, 0.95), percentile(all, 0.99), percentile(all, 0.999), all.empty() ? 0.0 : all.back() / 1000.0);
+    printf("  Records:         %u stored, %u acknowledged\n", total.stored, total.acked);
+    return reported == options.devices ? 0 : 1;
+}
+#endif
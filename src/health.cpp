@@ -0,0 +1,87 @@
+#include "health.h"
+
+#include <Arduino.h>
+
+#include "eepromstore.h"
+#include "log.h"
+#include "measurementlog.h"
+#include "rtcc.h"
+#include "settings.h"
+
+Health::Health() {
+    connectMs = 0;
+    rssi = 0;
+    channel = 0;
+    tlsMs = 0;
+    lastWakeMs = 0;
+    sensorTimeouts = 0;
+    memset(sensorMs, 0, sizeof(sensorMs));
+}
+
+Health::~Health() {}
+
+bool Health::due(time_t now) {
+    uint32_t interval = settings.store.healthinterval ? settings.store.healthinterval : SETTINGS_DEFAULT_HEALTHINTERVAL;
+    // A clock set backwards would otherwise hold the next record off until it caught up.
+    if ((uint32_t)now < Clock.store.lastHealth) return true;
+    return (uint32_t)now - Clock.store.lastHealth >= interval * 60;
+}
+
+bool Health::record(const Measurement& sample) {
+    Measurement m;
+    m.type = Measurement::TYPE_HEALTH;
+    m.bits = sample.bits;
+    m.timestamp = sample.timestamp;
+    m.batteryvoltage = sample.batteryvoltage;
+    m.freeheap = ESP.getFreeHeap();
+    m.maxfreeblock = ESP.getMaxFreeBlockSize();
+    m.rssi = (uint32_t)rssi;
+    m.wifichannel = channel;
+    m.connectms = connectMs;
+    m.tlsms = tlsMs;
+    m.eepromwrites = eepromStore.pageWrites;
+    m.eepromretries = eepromStore.writeRetries;
+    m.wakems = lastWakeMs;
+    m.resetreason = ESP.getResetInfoPtr()->reason;
+    m.sensortimeouts = sensorTimeouts;
+    m.sensorms = 0;
+    for (int t = 0; t < ACQUISITION_MAX_TASKS; t++) m.sensorms |= (uint32_t)sensorMs[t] << (8 * t);
+    // Set first so the store write of append saves it.
+    uint32_t previous = Clock.store.lastHealth;
+    Clock.store.lastHealth = sample.timestamp;
+    if (!measurementLog.append(m)) {
+        Clock.store.lastHealth = previous;
+        LogError::println("Failed to store health record");
+        return false;
+    }
+    sensorTimeouts = 0;
+    memset(sensorMs, 0, sizeof(sensorMs));
+    return true;
+}
+
+void Health::connected(uint32_t connectMs, int32_t rssi, uint8_t channel) {
+    this->connectMs = connectMs;
+    this->rssi = rssi;
+    this->channel = channel;
+}
+
+void Health::tlsDone(uint32_t handshakeMs) {
+    tlsMs = handshakeMs;
+}
+
+void Health::wakeDone(uint32_t wakeMs) {
+    lastWakeMs = wakeMs;
+}
+
+void Health::sensorsDone(const AcquisitionTiming& timing) {
+    sensorTimeouts |= timing.timedOut;
+    for (int t = 0; t < ACQUISITION_MAX_TASKS; t++) {
+        if (!timing.done[t]) continue;
+        // Rounded up, ACQUISITION_TIMEOUT_MS fits in a byte of 8 ms units.
+        uint32_t units = ((timing.done[t] - timing.started[t]) / 1000 + 7) / 8;
+        if (units > 0xff) units = 0xff;
+        if (units > sensorMs[t]) sensorMs[t] = units;
+    }
+}
+
+Health health;
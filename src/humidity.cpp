@@ -0,0 +1,29 @@
+#include "humidity.h"
+
+#include "pinout.h"
+
+Humidity::Humidity() : dht(GPIO_DHT, DHT22) {
+    haveDht = false;
+}
+
+Humidity::~Humidity() {}
+
+void Humidity::setup(void) {
+    dht.begin();
+    haveDht = true;
+}
+
+bool Humidity::start(void) {
+    return haveDht;
+}
+
+bool Humidity::poll(void) {
+    return true;
+}
+
+void Humidity::read(Measurement& m) {
+    if (!dht.read()) return;
+    // Values are cached by read() above, these won't touch the bus again.
+    m.humidity = dht.readHumidity();
+    m.humidtemp = dht.readTemperature();
+}
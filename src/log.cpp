@@ -0,0 +1,43 @@
+#include "log.h"
+
+LogSink::LogSink() {
+    dropped = 0;
+    head = 0;
+    tail = 0;
+}
+
+LogSink::~LogSink() {}
+
+size_t LogSink::write(uint8_t c) {
+    uint16_t next = (head + 1) % LOG_BUFFER_SIZE;
+    if (next == tail) {
+        dropped++;
+        return 0;
+    }
+    buffer[head] = c;
+    head = next;
+    return 1;
+}
+
+void LogSink::pump(void) {
+    int room = Serial.availableForWrite();
+    while (room-- > 0 && tail != head) {
+        Serial.write((uint8_t)buffer[tail]);
+        tail = (tail + 1) % LOG_BUFFER_SIZE;
+    }
+}
+
+void LogSink::drain(void) {
+    while (tail != head) {
+        pump();
+        yield();
+    }
+    if (dropped) {
+        Serial.print("[log dropped ");
+        Serial.print(dropped);
+        Serial.println(" bytes]");
+        dropped = 0;
+    }
+}
+
+LogSink logSink;
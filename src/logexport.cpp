@@ -0,0 +1,69 @@
+#include "logexport.h"
+
+#include <Arduino.h>
+#include <CRC32.h>
+
+#include "eepromstore.h"
+
+static void putU32(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+LogExport::LogExport() {
+    static_assert(sizeof(ExportFrame) == EEPROM_PAGESIZE + 10, "ExportFrame has wrong size.");
+}
+
+LogExport::~LogExport() {}
+
+bool LogExport::run(uint32_t firstPage, uint32_t count) {
+    uint8_t buf[EXPORT_CHUNK_PAGES * EEPROM_PAGESIZE];
+    uint32_t sent = 0;
+
+    if (firstPage + count > eepromStore.getMaxPages()) return false;
+
+    Serial.print("EXPORT ");
+    Serial.print(firstPage);
+    Serial.print(" ");
+    Serial.print(count);
+    Serial.print(" ");
+    Serial.println(EXPORT_BAUD);
+    Serial.flush();
+    delay(EXPORT_SWITCH_MS);
+    Serial.begin(EXPORT_BAUD);
+    delay(EXPORT_SWITCH_MS);
+
+    while (sent < count) {
+        uint32_t chunk = count - sent;
+        if (chunk > EXPORT_CHUNK_PAGES) chunk = EXPORT_CHUNK_PAGES;
+        if (!eepromStore.readPages(buf, firstPage + sent, chunk)) break;
+        for (uint32_t p = 0; p < chunk; p++) {
+            sendFrame(firstPage + sent + p, &buf[p * EEPROM_PAGESIZE]);
+        }
+        sent += chunk;
+        yield();
+    }
+
+    memset(buf, 0, EEPROM_PAGESIZE);
+    putU32(buf, sent);
+    sendFrame(EXPORT_END_PAGE, buf);
+
+    Serial.flush();
+    delay(EXPORT_SWITCH_MS);
+    Serial.begin(EXPORT_CONSOLE_BAUD);
+    return sent == count;
+}
+
+void LogExport::sendFrame(uint32_t page, uint8_t* data) {
+    ExportFrame frame;
+    frame.magic[0] = EXPORT_MAGIC0;
+    frame.magic[1] = EXPORT_MAGIC1;
+    putU32(frame.page, page);
+    memcpy(frame.data, data, EEPROM_PAGESIZE);
+    putU32(frame.crc, CRC32::calculate(frame.page, sizeof(frame.page) + sizeof(frame.data)));
+    Serial.write((uint8_t*)&frame, sizeof(frame));
+}
+
+LogExport logExport;
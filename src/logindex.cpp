@@ -0,0 +1,119 @@
+#include "logindex.h"
+
+#include <CRC32.h>
+
+#include "log.h"
+#include "measurementlog.h"
+#include "rtcc.h"
+
+LogIndex::LogIndex() {
+    static_assert(sizeof(LogIndexPage) == EEPROM_PAGESIZE, "LogIndexPage has wrong size.");
+    static_assert(EEPROM_PAGESPERCHIP % LOGINDEX_STRIDE == 0 && EEPROM_FIRST_SENSORPAGE % LOGINDEX_STRIDE == 0,
+                  "Blocks must not straddle the end of the ring.");
+    static_assert(((EEPROM_MAX_CHIPS * EEPROM_PAGESPERCHIP - EEPROM_FIRST_SENSORPAGE) / LOGINDEX_STRIDE +
+                   LOGINDEX_ENTRIES_PER_PAGE - 1) / LOGINDEX_ENTRIES_PER_PAGE <=
+                      EEPROM_LAST_INDEXPAGE - EEPROM_FIRST_INDEXPAGE + 1,
+                  "Index does not fit its pages.");
+    lastReads = 0;
+}
+
+LogIndex::~LogIndex() {}
+
+void LogIndex::update(uint32_t seq, uint32_t timestamp) {
+    if (seq % LOGINDEX_STRIDE != 0) return;
+    uint32_t block = (seq % measurementLog.capacity()) / LOGINDEX_STRIDE;
+    uint32_t pageNo = block / LOGINDEX_ENTRIES_PER_PAGE;
+    LogIndexPage page;
+    if (!loadPage(page, pageNo)) rebuild(page, pageNo);
+    page.entries[block % LOGINDEX_ENTRIES_PER_PAGE].seq = seq;
+    page.entries[block % LOGINDEX_ENTRIES_PER_PAGE].timestamp = timestamp;
+    savePage(page, pageNo);
+}
+
+uint32_t LogIndex::find(uint32_t timestamp) {
+    uint32_t capacity = measurementLog.capacity();
+    uint32_t next = Clock.store.nextId;
+    uint32_t oldest = next > capacity ? next - capacity : 0;
+    lastReads = 0;
+
+    // Blocks in sequence order, the scan starts at the last block starting before timestamp.
+    // Index pages are read and brought up to date as the walk reaches them, one at a time.
+    LogIndexPage page;
+    uint32_t pageNo = LOGINDEX_EMPTY;
+    uint32_t scanFrom = oldest;
+    uint32_t scanTo = next;
+    for (uint32_t seq = (oldest + LOGINDEX_STRIDE - 1) / LOGINDEX_STRIDE * LOGINDEX_STRIDE; seq < next; seq += LOGINDEX_STRIDE) {
+        uint32_t block = (seq % capacity) / LOGINDEX_STRIDE;
+        if (block / LOGINDEX_ENTRIES_PER_PAGE != pageNo) {
+            pageNo = block / LOGINDEX_ENTRIES_PER_PAGE;
+            // An unreadable page fails the CRC check in rebuild
+            if (!loadPage(page, pageNo)) memset(&page, 0, sizeof(page));
+            if (rebuild(page, pageNo)) savePage(page, pageNo);
+        }
+        LogIndexEntry& entry = page.entries[block % LOGINDEX_ENTRIES_PER_PAGE];
+        if (entry.timestamp >= timestamp) {
+            scanTo = seq;
+            break;
+        }
+        scanFrom = seq;
+    }
+
+    Measurement m;
+    for (uint32_t seq = scanFrom; seq < scanTo; seq++) {
+        lastReads++;
+        if (measurementLog.read(m, seq) && m.timestamp >= timestamp) return seq;
+    }
+    return scanTo;
+}
+
+uint32_t LogIndex::blocks(void) {
+    return measurementLog.capacity() / LOGINDEX_STRIDE;
+}
+
+// Sequence number of the record at the start of the block now, LOGINDEX_EMPTY if none has been stored there yet.
+uint32_t LogIndex::blockStart(uint32_t block) {
+    uint32_t capacity = measurementLog.capacity();
+    uint32_t first = block * LOGINDEX_STRIDE;
+    if (block >= blocks() || Clock.store.nextId <= first) return LOGINDEX_EMPTY;
+    return first + (Clock.store.nextId - 1 - first) / capacity * capacity;
+}
+
+// Brings the entries that do not match their block start up to date, returns true if any changed.
+bool LogIndex::rebuild(LogIndexPage& page, uint32_t pageNo) {
+    bool valid = page.crc == CRC32::calculate((uint8_t*)&page, sizeof(page) - sizeof(page.crc));
+    bool changed = !valid;
+    Measurement m;
+    for (int n = 0; n < LOGINDEX_ENTRIES_PER_PAGE; n++) {
+        LogIndexEntry& entry = page.entries[n];
+        uint32_t seq = blockStart(pageNo * LOGINDEX_ENTRIES_PER_PAGE + n);
+        if (valid && entry.seq == seq) continue;
+        entry.seq = seq;
+        entry.timestamp = 0;
+        changed = true;
+        if (seq == LOGINDEX_EMPTY) continue;
+        lastReads++;
+        // An unreadable block start keeps timestamp 0, lookups then scan from the block before.
+        if (measurementLog.read(m, seq)) entry.timestamp = m.timestamp;
+    }
+    if (changed) {
+        LogDebug::print("Rebuilt index page ");
+        LogDebug::println(pageNo);
+    }
+    return changed;
+}
+
+bool LogIndex::loadPage(LogIndexPage& page, uint32_t pageNo) {
+    if (!eepromStore.readPage((uint8_t*)&page, EEPROM_FIRST_INDEXPAGE + pageNo)) return false;
+    return page.crc == CRC32::calculate((uint8_t*)&page, sizeof(page) - sizeof(page.crc));
+}
+
+void LogIndex::savePage(LogIndexPage& page, uint32_t pageNo) {
+    page.reserved = 0;
+    page.crc = CRC32::calculate((uint8_t*)&page, sizeof(page) - sizeof(page.crc));
+    if (!eepromStore.writePage((uint8_t*)&page, EEPROM_FIRST_INDEXPAGE + pageNo)) {
+        LogError::print("Index page write failed ");
+        LogError::println(pageNo);
+    }
+}
+
+LogIndex logIndex;
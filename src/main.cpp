@@ -6,30 +6,93 @@
 #include <SPI.h>
 #include <Wire.h>
 
+#include "acquisition.h"
+#include "aggregator.h"
 #include "barometric.h"
+#include "battery.h"
 #include "communication.h"
 #include "eepromstore.h"
+#include "energy.h"
+#include "humidity.h"
+#include "log.h"
 #include "measurement.h"
+#include "measurementlog.h"
 #include "pinout.h"
 #include "rtcc.h"
 #include "settings.h"
+#include "shell.h"
+#include "tempsensors.h"
 #include "tools.h"
+#include "trace.h"
+#include "uploadpolicy.h"
+#include "wakecycle.h"
+#include "wakeschedule.h"
 
 OneWire oneWire(GPIO_1WIRE);
 Adafruit_MCP23017 ioexpander;
 Barometric barometric;
+TempSensors tempSensors(oneWire);
+Humidity humidity;
+
+#define CONFIG_WINDOW_MS 5000  // How long a cold boot waits for serial input before measuring
+
+// Gives the user a chance to start the configuration by sending anything over serial.
+// Returns as soon as input arrives.
+static bool waitForSerial(uint32_t timeoutMs) {
+    Serial.print("Send any key to enter setup");
+    uint32_t start = millis();
+    while (millis() - start < timeoutMs) {
+        if (Serial.available()) {
+            Serial.println();
+            return true;
+        }
+        delay(10);
+    }
+    Serial.println();
+    return false;
+}
+
+// Waits ms milliseconds, serving the shell while a session is open.
+static void idle(uint32_t ms) {
+    uint32_t start = millis();
+    while (shell.poll() && millis() - start < ms) {
+        delay(SHELL_POLL_MS);
+    }
+    uint32_t elapsed = millis() - start;
+    if (elapsed < ms) delay(ms - elapsed);
+}
+
+// Waits for the next sample slot, returns the time waited. The ESP timer covers all but the last second,
+// which the RTCC alarm ends on the slot's second boundary. Once the firmware deep sleeps this becomes
+// ESP.deepSleep until SCHEDULE_FALLBACK_MS past the slot, with the alarm waking it through RTCC_MFP_WAKE.
+static uint32_t sleepUntilSlot(void) {
+    uint32_t start = millis();
+    time_t now = Clock.getTime();
+    time_t slot = wakeSchedule.arm(now, settings.store.sampleinterval);
+    if (slot - now > 1) idle((slot - now - 1) * 1000UL);
+    uint32_t pollStart = millis();
+    bool fired = Clock.alarmFired();
+    while (!fired && millis() - pollStart < 1000 + SCHEDULE_FALLBACK_MS) {
+        idle(SCHEDULE_POLL_MS);
+        fired = Clock.alarmFired();
+    }
+    wakeSchedule.woke(fired);
+    return millis() - start;
+}
 
 // Todo: replace with own main, there will be no loop, only startup->init->measure->xmit->deep sleep.
 void setup() {
     bool clockWasRunning = false;
     bool powerUp = false;
 
+    TRACE_WAKE();
+    TRACE_BEGIN(TRACE_BOOT);
     Serial.begin(115200);
+    Comms.end();  // The radio comes up powered, it stays off unless this wake needs it
     Wire.begin();  // I2C
     SPI.begin();
 
-    delay(1000);
-    Serial.print("INIT");
+    LogInfo::println("INIT");
 
     // 1. init clock, note if running and if there was a powerfail
     Clock.begin();  // RTCC
@@ -50,12 +113,18 @@ void setup() {
     ioexpander.pinMode(IOEXP_EEPROM2, OUTPUT);
     ioexpander.pinMode(IOEXP_EEPROM3, OUTPUT);
     ioexpander.pinMode(IOEXP_EEPROM4, OUTPUT);
+    ioexpander.pinMode(IOEXP_EXTPOWR, INPUT);
+    ioexpander.pinMode(IOEXP_CONFIG, INPUT);
+    ioexpander.pullUp(IOEXP_CONFIG, HIGH);
 
     uint8_t buf[EEPROM_PAGESIZE];
+    TRACE_BEGIN(TRACE_SETTINGS);
     eepromStore.readPage(buf, EEPROM_SETTINGS_PAGE);
-    if (!settings.setFromBuf(buf)) {
-        Serial.println();
-        Serial.println("Failed to load settings from EEPROM, using default settings.");
+    bool settingsLoaded = settings.setFromBuf(buf);
+    TRACE_END(TRACE_SETTINGS);
+    if (!settingsLoaded) {
+        LogError::println();
+        LogError::println("Failed to load settings from EEPROM, using default settings.");
         settings.copyToBuf(buf);
         eepromStore.writePage(buf, 0);
     }
@@ -64,56 +133,55 @@ void setup() {
     if (settings.store.serialno == 0) {
         forceSetup = true;
     } else {
-        if (!settings.registered && (!settings.urlSet || !settings.registrationTokenSet)) {
+        if (!settings.registered && (!settings.urlSet || (!settings.registrationTokenSet && !settings.datagramUrl))) {
             forceSetup = true;
         }
     }
 
-    // Delay startup by 5 seconds to allow user to start sending text via serial (TODO: Should only be done on powerup, but then wait much longer)
+    logSink.drain();  // Interactive setup below talks to Serial directly.
+
+    // 2.8 Only a cold start (RTCC stopped or power failed) or the config strap opens the configuration window,
+    // a wake from deep sleep goes straight on to measuring.
+    bool openConfig = forceSetup;
     if (!forceSetup) {
-        for (int d = 0; d < 5; d++) {
-            if (Serial.available()) break;
-            delay(1000);
-            Serial.print(".");
-        }
-        Serial.println();
+        bool coldStart = !clockWasRunning || powerUp;
+        battery.readInputs();
+        if (coldStart || battery.configStrap) openConfig = waitForSerial(CONFIG_WINDOW_MS);
     }
 
-    // 2.9 Allow settings to be changed.
-    if (forceSetup || Serial.available()) {
-        if (settings.configure()) {
-            Serial.println("Writing settings to EEPROM");
-            settings.copyToBuf(buf);
-            eepromStore.writePage(buf, 0);
+    // 2.9 Allow settings to be changed. Without the basic settings there is nothing to do but wait for them,
+    // otherwise the shell is served from loop() while sampling.
+    if (openConfig) {
+        shell.open();
+        if (forceSetup) {
+            while (shell.poll()) delay(SHELL_POLL_MS);
         }
     }
 
     eepromStore.updateMaxPages(settings.store.numeeprom * EEPROM_PAGESPERCHIP);
+    eepromStore.setClock(settings.store.spiclock);
 
     // 3. Once we have settings loaded: IF clock is running but there was a powerfail, log that to eeprom
     if (Clock.powerfail) {
-        Serial.print("Power failed:   ");
-        Serial.println(Clock.powerfail);
-        Serial.print("Power returned: ");
-        Serial.println(Clock.powerreturn);
+        LogInfo::print("Power failed:   ");
+        LogInfo::println(Clock.powerfail);
+        LogInfo::print("Power returned: ");
+        LogInfo::println(Clock.powerreturn);
+
+        if (!measurementLog.appendPowerFail(Clock.getTime(), Clock.powerfail, Clock.powerreturn)) {
+            LogError::println("Failed to store powerfail event");
+        }
     }
 
     // 3.5 Now is also a great time to check if nextId == 0 -> we need to scan EEPROM storage to find last used id.
 
     // 4. If clock is not running, start radio to run NTP to set it before doing any measurements. If NTP fails, sleep for a few minutes and try again.
-    Comms.begin();
-    time_t ntpnow = Comms.getNtpTime();
-
+    // A running clock is checked on upload wakes instead, so a boot does not power the radio.
     if (!Clock.running) {
-        Clock.setTime(ntpnow);
-    } else {
-        time_t rtcNow = Clock.getTime();
-        int delta = ntpnow - rtcNow;
-        Serial.print("RTC NTP Delta: ");
-        Serial.println(delta);
-        Serial.print("RTC TIME: ");
-        Serial.println(rtcNow);
-        if (delta > 3600 || delta < -3600) Clock.setTime(ntpnow);
+        uint32_t radioStart = millis();
+        if (Comms.begin()) wakeCycle.syncClock(Comms);
+        uploadPolicy.chargeRadio(Clock.getTime(), millis() - radioStart);
+        Comms.end();
     }
 
     // 5. Startup sensors - If clock was running and no powerfail all sensors should have sane settings already.
@@ -121,46 +189,50 @@ void setup() {
         barometric.setup();
     }
     if (settings.store.dhtavail) {
-        // TODO: Init DHT
+        humidity.setup();
     }
+    tempSensors.setup(settings.store.numtempsens, settings.store.tempresolution);
+    aggregator.begin();
 
-    if (settings.store.serialno != 0 && settings.urlSet && settings.registrationTokenSet && !settings.registered) {
-        Comms.begin();
-        Comms.registerDevice();
-    }
+    // Slowest sensor first so its conversion is started as early as possible.
+    acquisition.add(&tempSensors, "1Wire");
+    acquisition.add(&barometric, "Baro");
+    acquisition.add(&humidity, "DHT");
+    acquisition.add(&battery, "Battery");
 
+    // Registration is retried along with uploads, samples are logged locally meanwhile.
     if (!settings.registered) {
-        Serial.println("Restarting to retry setting up and registering.");
-        delay(5000);
-        ESP.restart();
+        LogError::println("Not registered yet.");
     }
     // Setup done.
-    delay(5000);
-    Serial.println("Booting");
+    LogInfo::println("Booting");
 }
 
 void scanAndPrintOneWire(void);
 void runRTCC(void);
 
 void loop() {
-    Serial.print("#");
-#if 0
-    Measurement m;
-    barometric.measure(m);
-    Serial.print("Baro: ");
-    Serial.println(m.baropress);
-    m.genCrc();
-    if (m.checkCrc()) {
-        Serial.println("CRC Ok");
+    static bool firstSample = true;
+    if (firstSample) {
+        TRACE_END(TRACE_BOOT);
+        LogInfo::print("Boot to first sample: ");
+        LogInfo::print(millis());
+        LogInfo::println(" ms");
+        firstSample = false;
+    }
+    wakeCycle.run(Comms);
+    if (Comms.configApplied) {
+        tempSensors.setup(settings.store.numtempsens, settings.store.tempresolution);
+        Comms.configApplied = false;
     }
-#endif
 
 #if 0
     // Check one-wire
     scanAndPrintOneWire();   
     runRTCC();
 #endif
-    delay(15000);
+    // The wait runs on the CPU until the firmware deep sleeps, only the simulator books it as sleep.
+    energy.add(ENERGY_CPU, sleepUntilSlot() * 1000ULL);
 }
 
 void scanAndPrintOneWire(void) {
@@ -1,17 +1,21 @@
 #include "measurement.h"
 
+#include <Arduino.h>
 #include <CRC32.h>
 
 #include "eepromstore.h"
+#include "log.h"
 
 Measurement::Measurement() {
     static_assert(sizeof(Measurement) == EEPROM_PAGESIZE, "Measurement has wrong size.");
+    // Header, the channels and the CRC fill the page, exportlog.py and the binary upload rely on it.
+    static_assert(sizeof(Measurement) == 8 + MEASUREMENT_CHANNELS * sizeof(float) + sizeof(uint32_t),
+                  "Measurement channels have wrong layout.");
     type = TYPE_SENSORREAD;
     id = 0xDEAD;  // Should call settings for next id.
     bits = 0;
     timestamp = 0;
-    batteryvoltage = baropress = barotemp = humidity = humidtemp =
-        tempsens0 = tempsens1 = tempsens2 = tempsens3 = tempsens4 = tempsens5 = tempsens6 = tempsens7 = NaN();
+    for (int c = 0; c < MEASUREMENT_CHANNELS; c++) this->*channels[c].field = NaN();
     crc = 0;
 }
 
@@ -28,13 +32,13 @@ float Measurement::NaN() {
 void Measurement::genCrc() {
     uint32_t newCrc = CRC32::calculate((uint8_t*)this, sizeof(Measurement) - sizeof(crc));
     crc = newCrc;
-    Serial.print("CRC Generated: ");
-    Serial.println(crc, HEX);
+    LogDebug::print("CRC Generated: ");
+    LogDebug::println(crc, HEX);
 }
 
 bool Measurement::checkCrc() {
     uint32_t crcCheck = CRC32::calculate((uint8_t*)this, sizeof(Measurement) - sizeof(crc));
-    Serial.print("CRC Check: ");
-    Serial.println(crcCheck, HEX);
+    LogDebug::print("CRC Check: ");
+    LogDebug::println(crcCheck, HEX);
     return crc == crcCheck;
 }
@@ -0,0 +1,72 @@
+#include "measurementlog.h"
+
+#include "eepromstore.h"
+#include "logindex.h"
+#include "rtcc.h"
+#include "trace.h"
+
+MeasurementLog::MeasurementLog() {}
+
+MeasurementLog::~MeasurementLog() {}
+
+bool MeasurementLog::append(Measurement& m) {
+    uint32_t seq = Clock.store.nextId;
+    TRACE_BEGIN(TRACE_APPEND);
+    m.id = seq & 0xffff;
+    m.genCrc();
+    if (!eepromStore.writePage((uint8_t*)&m, getPage(seq))) {
+        TRACE_END(TRACE_APPEND);
+        return false;
+    }
+
+    Clock.store.nextId = seq + 1;
+    // Oldest unsent record was just overwritten.
+    if (Clock.store.nextId - Clock.store.lastSentId > capacity()) {
+        Clock.store.lastSentId = Clock.store.nextId - capacity();
+    }
+    Clock.saveStore();
+    logIndex.update(seq, m.timestamp);
+    TRACE_END(TRACE_APPEND);
+    return true;
+}
+
+bool MeasurementLog::appendPowerFail(uint32_t now, uint32_t powerfail, uint32_t powerback) {
+    Measurement pwr;
+    pwr.type = Measurement::TYPE_PWRFAIL;
+    pwr.timestamp = now;
+    pwr.powerfail = powerfail;
+    pwr.powerback = powerback;
+    return append(pwr);
+}
+
+bool MeasurementLog::read(Measurement& m, uint32_t seq) {
+    if (seq >= Clock.store.nextId || Clock.store.nextId - seq > capacity()) return false;
+    if (!eepromStore.readPage((uint8_t*)&m, getPage(seq))) return false;
+    return m.checkCrc() && m.id == (seq & 0xffff);
+}
+
+uint32_t MeasurementLog::pending(void) {
+    return Clock.store.nextId - Clock.store.lastSentId;
+}
+
+bool MeasurementLog::acknowledge(uint32_t ack) {
+    uint32_t next = ack + 1;
+    if (next > Clock.store.nextId) return false;
+    // A server that lost records gets them again if they are still in the log.
+    if (Clock.store.nextId - next > capacity()) next = Clock.store.nextId - capacity();
+    if (next != Clock.store.lastSentId) {
+        Clock.store.lastSentId = next;
+        Clock.saveStore();
+    }
+    return true;
+}
+
+uint32_t MeasurementLog::capacity(void) {
+    return eepromStore.getMaxPages() - EEPROM_FIRST_SENSORPAGE;
+}
+
+uint32_t MeasurementLog::getPage(uint32_t seq) {
+    return EEPROM_FIRST_SENSORPAGE + (seq % capacity());
+}
+
+MeasurementLog measurementLog;
@@ -4,12 +4,41 @@
 #include <Wire.h>
 #include <time.h>
 
+#include "log.h"
 #include "pinout.h"
 #include "tools.h"
+#include "trace.h"
 #include "eepromstore.h"
 
 
 #define RTCCADDR 0x6f
+#define RTCC_REG_CONTROL 0x07
+#define RTCC_REG_ALM0SEC 0x0a
+#define RTCC_REG_ALM0WKDAY 0x0d
+#define RTCC_CONTROL_ALM0EN 0x10
+#define RTCC_ALMWKDAY_MSK_ALL 0x70  // Match seconds, minutes, hours, weekday, date and month
+#define RTCC_ALMWKDAY_IF 0x08
+
+static uint8_t toBcd(int value) {
+    return ((value / 10) << 4) + (value % 10);
+}
+
+static uint8_t readRegister(uint8_t address) {
+    uint8_t value = 0;
+    Wire.beginTransmission(RTCCADDR);
+    Wire.write(address);
+    Wire.endTransmission();
+    Wire.requestFrom(RTCCADDR, 1);
+    if (Wire.available()) Wire.readBytes(&value, 1);
+    return value;
+}
+
+static void writeRegister(uint8_t address, uint8_t value) {
+    Wire.beginTransmission(RTCCADDR);
+    Wire.write(address);
+    Wire.write(value);
+    Wire.endTransmission();
+}
 
 RTCC::RTCC() {
     static_assert(sizeof(RTCCmem) == EEPROM_PAGESIZE, "RTCCmem has wrong size.");
@@ -21,6 +50,7 @@ RTCC::~RTCC() {}
 
 void RTCC::begin(void) {
     // Check if OSCILLATOR running and read SRAM.
+    TRACE_BEGIN(TRACE_RTCC);
 
     uint8_t clockbuf[8];
     int received = 0;
@@ -77,28 +107,29 @@ void RTCC::begin(void) {
     if (!loadStore()) {
         saveStore();
     }
+    TRACE_END(TRACE_RTCC);
 }
 
 void RTCC::setTime(time_t newTime) {
     tm* timeinfo = gmtime(&newTime);
     if(timeinfo->tm_year<100){
-        Serial.println("Refusing to update clock with bad time.");
+        LogError::println("Refusing to update clock with bad time.");
         return;
     }
-    Serial.print("Asked to set time to: ");
-    Serial.print(timeinfo->tm_year);
-    Serial.print("-");
-    Serial.print(timeinfo->tm_mon);
-    Serial.print("-");
-    Serial.print(timeinfo->tm_mday);
-    Serial.print(" ");
-
-    Serial.print(timeinfo->tm_hour);
-    Serial.print(":");
-    Serial.print(timeinfo->tm_min);
-    Serial.print(":");
-    Serial.print(timeinfo->tm_sec);
-    Serial.println();
+    LogInfo::print("Asked to set time to: ");
+    LogInfo::print(timeinfo->tm_year);
+    LogInfo::print("-");
+    LogInfo::print(timeinfo->tm_mon);
+    LogInfo::print("-");
+    LogInfo::print(timeinfo->tm_mday);
+    LogInfo::print(" ");
+
+    LogInfo::print(timeinfo->tm_hour);
+    LogInfo::print(":");
+    LogInfo::print(timeinfo->tm_min);
+    LogInfo::print(":");
+    LogInfo::print(timeinfo->tm_sec);
+    LogInfo::println();
 
     uint8_t clockbuf[9];
     clockbuf[0] = ((timeinfo->tm_sec / 10) << 4) + (timeinfo->tm_sec % 10);
@@ -147,7 +178,7 @@ void RTCC::setTime(time_t newTime) {
             running = 1;
         } else {
             delay(100);
-            Serial.println("Waiting on oscillator");
+            LogDebug::println("Waiting on oscillator");
         }
     }
 }
@@ -174,6 +205,7 @@ time_t RTCC::getTime(void) {
     timeinfo.tm_mday = (clockbuf[4] & 0x0f) + 10 * ((clockbuf[4] & 0x30) >> 4);
     timeinfo.tm_mon = ((clockbuf[5] & 0x0f) + 10 * ((clockbuf[5] & 0x10) >> 4)) - 1;
     timeinfo.tm_year = (clockbuf[6] & 0x0f) + 10 * ((clockbuf[6] & 0xf0) >> 4) + 100;
+    timeinfo.tm_isdst = 0;  // Uninitialized, mktime could apply DST and shift reads by an hour
 
     return mktime(&timeinfo);
 }
@@ -200,6 +232,32 @@ void RTCC::saveStore(void) {
     Wire.endTransmission();
 }
 
+void RTCC::setAlarm(time_t t) {
+    tm* timeinfo = gmtime(&t);
+    uint8_t alarmbuf[6];
+    alarmbuf[0] = toBcd(timeinfo->tm_sec);
+    alarmbuf[1] = toBcd(timeinfo->tm_min);
+    alarmbuf[2] = toBcd(timeinfo->tm_hour);
+    alarmbuf[3] = RTCC_ALMWKDAY_MSK_ALL + timeinfo->tm_wday + 1;  // ALMPOL low, clears the interrupt flag
+    alarmbuf[4] = toBcd(timeinfo->tm_mday);
+    alarmbuf[5] = toBcd(timeinfo->tm_mon + 1);
+
+    Wire.beginTransmission(RTCCADDR);
+    Wire.write(RTCC_REG_ALM0SEC);
+    Wire.write(alarmbuf, sizeof(alarmbuf));
+    Wire.endTransmission();
+    writeRegister(RTCC_REG_CONTROL, readRegister(RTCC_REG_CONTROL) | RTCC_CONTROL_ALM0EN);
+}
+
+bool RTCC::alarmFired(void) {
+    return readRegister(RTCC_REG_ALM0WKDAY) & RTCC_ALMWKDAY_IF;
+}
+
+void RTCC::clearAlarm(void) {
+    writeRegister(RTCC_REG_CONTROL, readRegister(RTCC_REG_CONTROL) & ~RTCC_CONTROL_ALM0EN);
+    writeRegister(RTCC_REG_ALM0WKDAY, readRegister(RTCC_REG_ALM0WKDAY) & ~RTCC_ALMWKDAY_IF);
+}
+
 RTCCmem::RTCCmem() {}
 
 RTCCmem::~RTCCmem() {}
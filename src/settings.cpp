@@ -1,13 +1,16 @@
 #include "settings.h"
 
+#include <Arduino.h>
 #include <CRC32.h>
 #include <errno.h>
 
 #include "eepromstore.h"
+#include "log.h"
 #include "tools.h"
 
 Settings::Settings() {
     urlSet = false;
+    datagramUrl = false;
     registrationTokenSet = false;
     registered = false;
 }
@@ -20,6 +23,7 @@ bool Settings::setFromBuf(uint8_t* buf) {
         eepromStore.readPage(eeprombuf, EEPROM_URL_PAGE);
         if (!(eeprombuf[0] == 0 || eeprombuf[0] == 0xff)) {
             urlSet = true;
+            datagramUrl = strncmp((char*)eeprombuf, "udp://", 6) == 0;
         }
         eepromStore.readPage(eeprombuf, EEPROM_REGISTER_SECRET_PAGE);
         if (!(eeprombuf[0] == 0 || eeprombuf[0] == 0xff)) {
@@ -39,233 +43,376 @@ void Settings::copyToBuf(uint8_t* buf) {
     store.copyToBuf(buf);
 }
 
-/* Configure Settings
+/* Set a setting from a shell line, see shell.cpp for the other commands.
    Settings tree
-    w - write settings to eeprom and continue boot
-    l - list settings
     s - set
         s <serialno> (in base10 format, can only be set ONCE)
         h <0,1> Set if humidity sensor is installed
         b <0,1> Set if barometer is installed
         e <1-5> Set number of EEPROMS installed
+        k <MHz> Set EEPROM SPI clock, 0 for the default. Checked per chip on first use
+        i <seconds> Set sample interval
+        p <minutes> Set upload interval when running on battery
+        n <count> Set number of samples to collect before uploading when running on battery
+        m <minutes> Set max interval between stored samples
+        r <seconds> Set radio time budget per day when running on battery
+        c <9-12> Set temperature sensor resolution in bits
+        d <t,h,p,v><hundredths> Set deadband for temperature, humidity, pressure or battery voltage
+        a <t,h,p,v><hundredths> Set alarm threshold for temperature, humidity, pressure or battery voltage
+        g <minutes> Set summary window, 0 disables summaries
+        l <minutes> Set health record interval, 0 for the default
+        o <0,1> Set if only summaries should be stored
         w <0-9> Setup WIFI credentials
             s ssid
             p psk
             c clear
-        u Set url (not including /api/) (Max 63 characters)
+        u Set url (not including /api/) (Max 63 characters), udp://host[:port] for a LAN collector
         t Set registration token secret (Max 63 characters)
 */
-bool Settings::configure(void) {
-    bool setupDone = false;
-    bool settingsChanged = false;
-    uint8_t serialBuffer[129];
+void Settings::list(void) {
     uint8_t eeprombufA[65];
     uint8_t eeprombufB[65];
-    size_t read = 0;
-    uint8_t newValue = 0;
-    uint8_t wifiNum = 0;
-    size_t len = 0;
-    uint32_t intermediate_u32 = 0;
 
-    while (!setupDone) {
-        Serial.setTimeout(30000);
-        read = Serial.readBytesUntil('\n', serialBuffer, 128);
-        if (read > 0) {
-            memset(eeprombufA, 0, sizeof(eeprombufA));
-            memset(eeprombufB, 0, sizeof(eeprombufB));
-            serialBuffer[read] = 0x00;                                        // Make sure string is asciiz (Will remove linefeed if string was short enough)
-            if (serialBuffer[read - 1] == 0x0d) serialBuffer[--read] = 0x00;  // Trim any CR
+    Serial.println("Current settings:      ");
+    Serial.print("Serial#:                 ");
+    Serial.println(store.serialno);
+    Serial.print("Barometer:               ");
+    if (store.bmpavail)
+        Serial.println("Available");
+    else
+        Serial.println("Not available");
 
-            switch ((char)serialBuffer[0]) {
-                case 'w':
-                    setupDone = true;
-                    break;
-                case 'l':
-                    Serial.println("Current settings:      ");
-                    Serial.print("Serial#:                 ");
-                    Serial.println(store.serialno);
-                    Serial.print("Barometer:               ");
-                    if (store.bmpavail)
-                        Serial.println("Available");
-                    else
-                        Serial.println("Not available");
+    Serial.print("Humidity:                ");
+    if (store.dhtavail)
+        Serial.println("Available");
+    else
+        Serial.println("Not available");
 
-                    Serial.print("Humidity:                ");
-                    if (store.dhtavail)
-                        Serial.println("Available");
-                    else
-                        Serial.println("Not available");
+    Serial.print("EEProms available:       ");
+    Serial.println(store.numeeprom);
+    Serial.print("EEPROM SPI clock (MHz):  ");
+    Serial.print(store.spiclock ? store.spiclock : EEPROM_SPI_DEFAULT_MHZ);
+    for (int c = 0; c < store.numeeprom; c++) {
+        Serial.print(c ? "/" : ", verified ");
+        Serial.print(eepromStore.getClock(c));
+    }
+    Serial.println();
 
-                    Serial.print("EEProms available:       ");
-                    Serial.println(store.numeeprom);
+    Serial.print("Tempsensors detected:    ");
+    Serial.println(store.numtempsens);
+    Serial.print("Temp resolution (bits):  ");
+    Serial.println(store.tempresolution);
 
-                    Serial.print("Tempsensors detected:    ");
-                    Serial.println(store.numtempsens);
+    Serial.print("Sample interval (s):     ");
+    Serial.println(store.sampleinterval);
+    Serial.print("Upload interval (min):   ");
+    Serial.println(store.uploadinterval);
+    Serial.print("Upload batch size:       ");
+    Serial.println(store.batchsize);
+    Serial.print("Max store interval (min):");
+    Serial.println(store.maxstoreinterval);
+    Serial.print("Radio budget (s/day):    ");
+    Serial.println(store.radiobudget);
+    Serial.println("Deadband/alarm (1/100):  T     H     P     V");
+    Serial.print("                         ");
+    for (int g = 0; g < CHANNEL_GROUPS; g++) {
+        Serial.print(store.deadband[g]);
+        Serial.print(" ");
+    }
+    Serial.println();
+    Serial.print("                         ");
+    for (int g = 0; g < CHANNEL_GROUPS; g++) {
+        Serial.print(store.alarm[g]);
+        Serial.print(" ");
+    }
+    Serial.println();
+    Serial.print("Summary window (min):    ");
+    Serial.println(store.aggregatewindow);
+    Serial.print("Health interval (min):   ");
+    Serial.println(store.healthinterval ? store.healthinterval : SETTINGS_DEFAULT_HEALTHINTERVAL);
+    Serial.print("Remote config version:   ");
+    Serial.println(store.configversion);
+    Serial.print("Store raw samples:       ");
+    if (store.aggregatemode == AGGREGATE_ONLY)
+        Serial.println("No");
+    else
+        Serial.println("Yes");
 
-                    eepromStore.readPage(eeprombufA, EEPROM_URL_PAGE);
-                    if (!(eeprombufA[0] == 0 || eeprombufA[0] == 0xff)) {
-                        eeprombufA[64] = 0x00;
-                        Serial.print("Server URL:              ");
-                        Serial.println((char*)eeprombufA);
-                    }
-                    eepromStore.readPage(eeprombufA, EEPROM_REGISTER_SECRET_PAGE);
-                    if (!(eeprombufA[0] == 0 || eeprombufA[0] == 0xff)) {
-                        eeprombufA[64] = 0x00;
-                        Serial.print("Register Secret Token:   ");
-                        Serial.println((char*)eeprombufA);
-                    }
+    eepromStore.readPage(eeprombufA, EEPROM_URL_PAGE);
+    if (!(eeprombufA[0] == 0 || eeprombufA[0] == 0xff)) {
+        eeprombufA[64] = 0x00;
+        Serial.print("Server URL:              ");
+        Serial.println((char*)eeprombufA);
+    }
+    eepromStore.readPage(eeprombufA, EEPROM_REGISTER_SECRET_PAGE);
+    if (!(eeprombufA[0] == 0 || eeprombufA[0] == 0xff)) {
+        eeprombufA[64] = 0x00;
+        Serial.print("Register Secret Token:   ");
+        Serial.println((char*)eeprombufA);
+    }
 
-                    Serial.print("Device Registration:     ");
-                    eepromStore.readPage(eeprombufA, EEPROM_DEVICE_TOKEN_PAGE);
-                    if (!(eeprombufA[0] == 0 || eeprombufA[0] == 0xff)) {  // TODO: Replace with CRC check once a registration has been tested
-                        Serial.println("YES");
-                    } else {
-                        Serial.println("NO");
-                    }
+    Serial.print("Device Registration:     ");
+    eepromStore.readPage(eeprombufA, EEPROM_DEVICE_TOKEN_PAGE);
+    if (!(eeprombufA[0] == 0 || eeprombufA[0] == 0xff)) {  // TODO: Replace with CRC check once a registration has been tested
+        Serial.println("YES");
+    } else {
+        Serial.println("NO");
+    }
 
-                    Serial.print("WIFI Credentials:        ");
-                    Serial.println(store.numwificreds);
-                    for (int c = 0; c < store.numwificreds; c++) {
-                        eepromStore.readPage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * c);
-                        if (eeprombufA[0] == 0xff) continue;  // Invalid setting.
-                        eepromStore.readPage(eeprombufB, EEPROM_FIRST_WIFIPAGE + 2 * c + 1);
-                        if (eeprombufB[0] == 0xff) continue;  // Invalid setting.
-                        Serial.print("    ");
-                        if (store.numwificreds < 10) Serial.print(" ");
-                        Serial.print(c);
-                        Serial.print(" SSID '");
-                        Serial.print((char*)eeprombufA);
-                        Serial.println("'");
-                        Serial.print("       PSK  '");
-                        Serial.print((char*)eeprombufB);
-                        Serial.println("'");
-                    }
+    Serial.print("WIFI Credentials:        ");
+    Serial.println(store.numwificreds);
+    for (int c = 0; c < store.numwificreds; c++) {
+        eepromStore.readPage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * c);
+        if (eeprombufA[0] == 0xff) continue;  // Invalid setting.
+        eepromStore.readPage(eeprombufB, EEPROM_FIRST_WIFIPAGE + 2 * c + 1);
+        if (eeprombufB[0] == 0xff) continue;  // Invalid setting.
+        Serial.print("    ");
+        if (store.numwificreds < 10) Serial.print(" ");
+        Serial.print(c);
+        Serial.print(" SSID '");
+        Serial.print((char*)eeprombufA);
+        Serial.println("'");
+        Serial.print("       PSK  '");
+        Serial.print((char*)eeprombufB);
+        Serial.println("'");
+    }
+}
 
-                    break;
-                case 's':
-                    if (read > 2) {
-                        switch ((char)serialBuffer[1]) {
-                            case 's':  // Serialno
-                                //TODO, leave if serial is already set.
-                                errno = 0;
-                                intermediate_u32 = strtoul((char*)&serialBuffer[2], NULL, 10);
+bool Settings::set(char* line, size_t lineLen) {
+    bool settingsChanged = false;
+    uint8_t eeprombufA[65];
+    uint8_t newValue = 0;
+    uint8_t wifiNum = 0;
+    size_t len = 0;
+    uint32_t intermediate_u32 = 0;
 
-                                if (errno == 0 && validateSerialNo(intermediate_u32)) {
-                                    store.serialno = intermediate_u32;
-                                    settingsChanged = true;
-                                }
-                                break;
-                            case 'h':  // DHT Humidity sensor available
-                                newValue = ((char)serialBuffer[2] == '1');
-                                if (newValue != store.dhtavail) {
-                                    store.dhtavail = newValue;
-                                    settingsChanged = true;
-                                }
-                                break;
-                            case 'b':  // BMP Pressure sensor available
-                                newValue = ((char)serialBuffer[2] == '1');
-                                if (newValue != store.bmpavail) {
-                                    store.bmpavail = newValue;
-                                    settingsChanged = true;
-                                }
-                                break;
-                            case 'e':  // Number of eeproms
-                                newValue = store.numeeprom;
-                                switch ((char)serialBuffer[2]) {
-                                    case '1':
-                                        newValue = 1;
-                                        break;
-                                    case '2':
-                                        newValue = 2;
-                                        break;
-                                    case '3':
-                                        newValue = 3;
-                                        break;
-                                    case '4':
-                                        newValue = 4;
-                                        break;
-                                    case '5':
-                                        newValue = 5;
-                                        break;
-                                    default:
-                                        Serial.println("Invalid number of eeproms.");
-                                }
-                                if (newValue != store.numeeprom) {
-                                    store.numeeprom = newValue;
-                                    settingsChanged = true;
-                                }
-                                break;
-                            case 'w':  // WIFI
-                                if (read < 4) continue;
-                                wifiNum = serialBuffer[2] - '0';
+    memset(eeprombufA, 0, sizeof(eeprombufA));
+    if (lineLen > 2) {
+        switch (line[1]) {
+            case 's':  // Serialno
+                //TODO, leave if serial is already set.
+                errno = 0;
+                intermediate_u32 = strtoul(&line[2], NULL, 10);
 
-                                if (wifiNum > (store.numwificreds + 1)) {
-                                    Serial.println("Store WIFI as next available");
-                                    continue;
-                                }
-                                if (wifiNum == store.numwificreds) {
-                                    store.numwificreds++;
-                                    settingsChanged = true;
-                                }
-                                len = read - 4;
-                                if (len > 64) continue;
-                                switch ((char)serialBuffer[3]) {
-                                    case 's':
-                                        memcpy(eeprombufA, &serialBuffer[4], len);
-                                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum);
-                                        break;
-                                    case 'p':
-                                        memcpy(eeprombufA, &serialBuffer[4], len);
-                                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum + 1);
-                                        break;
-                                    case 'c':
-                                        eeprombufA[0] = 0xFF;
-                                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum);
-                                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum + 1);
-                                        if (wifiNum == (store.numwificreds - 1) && store.numwificreds > 0) {
-                                            store.numwificreds--;
-                                            settingsChanged = true;
-                                        }
-                                        break;
-                                    default:
-                                        Serial.println("Unknown wifi option");
-                                }
-                                break;
-                            case 'u':  // Url
-                                len = read - 2;
-                                memcpy(eeprombufA, &serialBuffer[2], len);
-                                if (len == 1 && eeprombufA[0] == ' ') eeprombufA[0] = 0x00;
-                                eepromStore.writePage(eeprombufA, EEPROM_URL_PAGE);
-                                if (eeprombufA[0] != 0x00) urlSet = true;
-                                break;
-                            case 't':  // registration token secret
-                                len = read - 2;
-                                memcpy(eeprombufA, &serialBuffer[2], len);
-                                if (len == 1 && eeprombufA[0] == ' ') eeprombufA[0] = 0x00;
-                                eepromStore.writePage(eeprombufA, EEPROM_REGISTER_SECRET_PAGE);
-                                if (eeprombufA[0] != 0x00) registrationTokenSet = true;
-                                break;
-                            default:
-                                Serial.println("Unknown setting.");
-                                Serial.println((char*)serialBuffer);
-                        }
+                if (errno == 0 && validateSerialNo(intermediate_u32)) {
+                    store.serialno = intermediate_u32;
+                    settingsChanged = true;
+                }
+                break;
+            case 'h':  // DHT Humidity sensor available
+                newValue = (line[2] == '1');
+                if (newValue != store.dhtavail) {
+                    store.dhtavail = newValue;
+                    settingsChanged = true;
+                }
+                break;
+            case 'b':  // BMP Pressure sensor available
+                newValue = (line[2] == '1');
+                if (newValue != store.bmpavail) {
+                    store.bmpavail = newValue;
+                    settingsChanged = true;
+                }
+                break;
+            case 'e':  // Number of eeproms
+                newValue = store.numeeprom;
+                switch (line[2]) {
+                    case '1':
+                        newValue = 1;
+                        break;
+                    case '2':
+                        newValue = 2;
+                        break;
+                    case '3':
+                        newValue = 3;
+                        break;
+                    case '4':
+                        newValue = 4;
+                        break;
+                    case '5':
+                        newValue = 5;
+                        break;
+                    default:
+                        Serial.println("Invalid number of eeproms.");
+                }
+                if (newValue != store.numeeprom) {
+                    store.numeeprom = newValue;
+                    settingsChanged = true;
+                }
+                break;
+            case 'i':  // Sample interval
+            case 'p':  // Upload interval
+            case 'n':  // Batch size
+            case 'm':  // Max store interval
+            case 'r':  // Radio budget
+                errno = 0;
+                intermediate_u32 = strtoul(&line[2], NULL, 10);
+                if (errno != 0 || intermediate_u32 == 0 || intermediate_u32 > 0xffff) {
+                    Serial.println("Invalid value.");
+                    break;
+                }
+                if (line[1] == 'i') {
+                    uint16_t previous = store.sampleinterval;
+                    store.sampleinterval = intermediate_u32;
+                    if (!store.windowFits()) {
+                        store.sampleinterval = previous;
+                        Serial.println("Summary window would exceed 255 samples.");
+                        break;
                     }
+                }
+                if (line[1] == 'p') store.uploadinterval = intermediate_u32;
+                if (line[1] == 'n') store.batchsize = intermediate_u32;
+                if (line[1] == 'm') store.maxstoreinterval = intermediate_u32;
+                if (line[1] == 'r') store.radiobudget = intermediate_u32;
+                settingsChanged = true;
+                break;
+            case 'c':  // Temperature resolution
+                errno = 0;
+                intermediate_u32 = strtoul(&line[2], NULL, 10);
+                if (errno != 0 || intermediate_u32 < 9 || intermediate_u32 > 12) {
+                    Serial.println("Invalid value.");
                     break;
-                default:
-                    Serial.println("Unknown option.");
-            }
-        } else {
-            // TODO: #1 Should leave settings after a few read timeouts to make sure we boot even if we accidently entered config.
-            Serial.println("Didn't read anything.");
-        }
+                }
+                store.tempresolution = intermediate_u32;
+                settingsChanged = true;
+                break;
+            case 'k':  // EEPROM SPI clock
+                errno = 0;
+                intermediate_u32 = strtoul(&line[2], NULL, 10);
+                if (errno != 0 || intermediate_u32 > EEPROM_SPI_MAX_MHZ) {
+                    Serial.println("Invalid value.");
+                    break;
+                }
+                if (intermediate_u32 != store.spiclock) {
+                    store.spiclock = intermediate_u32;
+                    settingsChanged = true;
+                }
+                break;
+            case 'g':  // Summary window
+            case 'l':  // Health interval
+                errno = 0;
+                intermediate_u32 = strtoul(&line[2], NULL, 10);
+                if (errno != 0 || intermediate_u32 > 0xffff) {
+                    Serial.println("Invalid value.");
+                    break;
+                }
+                if (line[1] == 'g') {
+                    uint16_t previous = store.aggregatewindow;
+                    store.aggregatewindow = intermediate_u32;
+                    if (!store.windowFits()) {
+                        store.aggregatewindow = previous;
+                        Serial.println("Summary window would exceed 255 samples.");
+                        break;
+                    }
+                }
+                if (line[1] == 'l') store.healthinterval = intermediate_u32;
+                settingsChanged = true;
+                break;
+            case 'o':  // Summaries only
+                newValue = (line[2] == '1') ? AGGREGATE_ONLY : AGGREGATE_WITH_RAW;
+                if (newValue != store.aggregatemode) {
+                    store.aggregatemode = newValue;
+                    settingsChanged = true;
+                }
+                break;
+            case 'd':  // Deadband
+            case 'a':  // Alarm threshold
+                if (lineLen < 4) return settingsChanged;
+                switch (line[2]) {
+                    case 't':
+                        newValue = CHANNEL_TEMPERATURE;
+                        break;
+                    case 'h':
+                        newValue = CHANNEL_HUMIDITY;
+                        break;
+                    case 'p':
+                        newValue = CHANNEL_PRESSURE;
+                        break;
+                    case 'v':
+                        newValue = CHANNEL_BATTERY;
+                        break;
+                    default:
+                        Serial.println("Unknown channel.");
+                        return settingsChanged;
+                }
+                errno = 0;
+                intermediate_u32 = strtoul(&line[3], NULL, 10);
+                if (errno != 0 || intermediate_u32 > 0xffff) {
+                    Serial.println("Invalid value.");
+                    break;
+                }
+                if (line[1] == 'd') store.deadband[newValue] = intermediate_u32;
+                if (line[1] == 'a') store.alarm[newValue] = intermediate_u32;
+                settingsChanged = true;
+                break;
+            case 'w':  // WIFI
+                if (lineLen < 4) return settingsChanged;
+                wifiNum = line[2] - '0';
 
-        Serial.println("READY");
-        delay(100);
+                if (wifiNum > (store.numwificreds + 1)) {
+                    Serial.println("Store WIFI as next available");
+                    return settingsChanged;
+                }
+                if (wifiNum == store.numwificreds) {
+                    store.numwificreds++;
+                    settingsChanged = true;
+                }
+                len = lineLen - 4;
+                if (len > 64) return settingsChanged;
+                switch (line[3]) {
+                    case 's':
+                        memcpy(eeprombufA, &line[4], len);
+                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum);
+                        break;
+                    case 'p':
+                        memcpy(eeprombufA, &line[4], len);
+                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum + 1);
+                        break;
+                    case 'c':
+                        eeprombufA[0] = 0xFF;
+                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum);
+                        eepromStore.writePage(eeprombufA, EEPROM_FIRST_WIFIPAGE + 2 * wifiNum + 1);
+                        if (wifiNum == (store.numwificreds - 1) && store.numwificreds > 0) {
+                            store.numwificreds--;
+                            settingsChanged = true;
+                        }
+                        break;
+                    default:
+                        Serial.println("Unknown wifi option");
+                }
+                break;
+            case 'u':  // Url
+                len = lineLen - 2;
+                if (len > 63) len = 63;  // Page holds 63 characters and a terminator
+                memcpy(eeprombufA, &line[2], len);
+                if (len == 1 && eeprombufA[0] == ' ') eeprombufA[0] = 0x00;
+                eepromStore.writePage(eeprombufA, EEPROM_URL_PAGE);
+                if (eeprombufA[0] != 0x00) urlSet = true;
+                datagramUrl = strncmp((char*)eeprombufA, "udp://", 6) == 0;
+                break;
+            case 't':  // registration token secret
+                len = lineLen - 2;
+                if (len > 63) len = 63;  // Page holds 63 characters and a terminator
+                memcpy(eeprombufA, &line[2], len);
+                if (len == 1 && eeprombufA[0] == ' ') eeprombufA[0] = 0x00;
+                eepromStore.writePage(eeprombufA, EEPROM_REGISTER_SECRET_PAGE);
+                if (eeprombufA[0] != 0x00) registrationTokenSet = true;
+                break;
+            default:
+                Serial.println("Unknown setting.");
+                Serial.println(line);
+        }
     }
-
     return settingsChanged;
 }
 
+void Settings::save(void) {
+    uint8_t buf[EEPROM_PAGESIZE];
+    copyToBuf(buf);
+    eepromStore.writePage(buf, EEPROM_SETTINGS_PAGE);
+    eepromStore.updateMaxPages(store.numeeprom * EEPROM_PAGESPERCHIP);
+    eepromStore.setClock(store.spiclock);
+}
+
 bool Settings::validateSerialNo(uint32_t serial) {
     // A valid serial has odd number of bits in first and last byte, and even in the middle two.
     int count = 0;
@@ -287,7 +434,14 @@ bool Settings::validateSerialNo(uint32_t serial) {
 }
 
 SettingsStorage::SettingsStorage() {
+    static_assert(sizeof(SettingsStorage) == EEPROM_PAGESIZE, "SettingsStorage has wrong size.");
     numeeprom = 1;
+    sampleinterval = SETTINGS_DEFAULT_SAMPLEINTERVAL;
+    uploadinterval = SETTINGS_DEFAULT_UPLOADINTERVAL;
+    batchsize = SETTINGS_DEFAULT_BATCHSIZE;
+    maxstoreinterval = SETTINGS_DEFAULT_MAXSTOREINTERVAL;
+    radiobudget = SETTINGS_DEFAULT_RADIOBUDGET;
+    tempresolution = SETTINGS_DEFAULT_TEMPRESOLUTION;
 }
 
 SettingsStorage::~SettingsStorage() {}
@@ -295,8 +449,8 @@ SettingsStorage::~SettingsStorage() {}
 void SettingsStorage::genCrc(void) {
     uint32_t newCrc = CRC32::calculate((uint8_t*)this, sizeof(SettingsStorage) - sizeof(crc));
     crc = newCrc;
-    Serial.print("CRC Generated: ");
-    Serial.println(crc, HEX);
+    LogDebug::print("CRC Generated: ");
+    LogDebug::println(crc, HEX);
 }
 
 bool SettingsStorage::checkCrc(void) {
@@ -306,9 +460,22 @@ bool SettingsStorage::checkCrc(void) {
 bool SettingsStorage::setFromBuf(uint8_t* buf) {
     if (!checkCrcBuf(buf, sizeof(SettingsStorage))) return false;
     memcpy((uint8_t*)this, buf, sizeof(SettingsStorage));
+    // Settings stored before these fields existed have them zeroed.
+    if (sampleinterval == 0) sampleinterval = SETTINGS_DEFAULT_SAMPLEINTERVAL;
+    if (uploadinterval == 0) uploadinterval = SETTINGS_DEFAULT_UPLOADINTERVAL;
+    if (batchsize == 0) batchsize = SETTINGS_DEFAULT_BATCHSIZE;
+    if (maxstoreinterval == 0) maxstoreinterval = SETTINGS_DEFAULT_MAXSTOREINTERVAL;
+    if (radiobudget == 0) radiobudget = SETTINGS_DEFAULT_RADIOBUDGET;
+    if (tempresolution < 9 || tempresolution > 12) tempresolution = SETTINGS_DEFAULT_TEMPRESOLUTION;
     return true;
 }
 
+bool SettingsStorage::windowFits(void) {
+    // Windows are aligned to the clock and samples to their slots, so a window holds at most window / interval
+    // samples, rounded up.
+    return (uint32_t)aggregatewindow * 60 <= (uint32_t)SETTINGS_MAX_WINDOW_SAMPLES * sampleinterval;
+}
+
 void SettingsStorage::copyToBuf(uint8_t* buf) {
     memcpy(buf, (uint8_t*)this, sizeof(SettingsStorage));
 }
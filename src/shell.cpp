@@ -0,0 +1,271 @@
+#include "shell.h"
+
+#include <Arduino.h>
+
+#include "eepromstore.h"
+#include "dnscache.h"
+#include "energy.h"
+#include "log.h"
+#include "logexport.h"
+#include "logindex.h"
+#include "measurementlog.h"
+#include "rtcc.h"
+#include "settings.h"
+#include "trace.h"
+#include "wakeschedule.h"
+
+/* Shell commands, one per line
+    h - list commands
+    l - list settings
+    s - set, see Settings::set
+    w - write changed settings to eeprom and leave
+    d [count] - dump the newest stored records
+    f <time> [count] - dump records from the first at or after a unix time, found with the log index
+    e [first] [count] - binary export of eeprom pages, see logexport.h
+    x - show log and runtime statistics
+    t - dump wake trace (not in release builds)
+    n - energy used per state since boot and mAh/day at that rate
+*/
+const Shell::Command Shell::commands[] = {
+    {'h', &Shell::help, "List commands"},
+    {'l', &Shell::list, "List settings"},
+    {'s', &Shell::set, "Set a setting"},
+    {'w', &Shell::write, "Write settings and leave"},
+    {'d', &Shell::dumpLog, "Dump newest records, d<count>"},
+    {'f', &Shell::findLog, "Dump records from a time, f<unix time> [count]"},
+    {'e', &Shell::exportPages, "Binary export, e<first> <count>"},
+    {'x', &Shell::stats, "Statistics"},
+#ifndef RELEASE
+    {'t', &Shell::dumpTrace, "Dump wake trace"},
+#endif
+    {'n', &Shell::energyReport, "Energy estimate"},
+};
+
+Shell::Shell() {
+    lineLen = 0;
+    isOpen = false;
+    settingsChanged = false;
+    lastInput = 0;
+}
+
+Shell::~Shell() {}
+
+void Shell::open(void) {
+    isOpen = true;
+    lineLen = 0;
+    settingsChanged = false;
+    lastInput = millis();
+    Serial.println("READY");
+}
+
+bool Shell::active(void) {
+    return isOpen;
+}
+
+bool Shell::poll(void) {
+    if (!isOpen) return false;
+
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        lastInput = millis();
+        if (c == '\r') continue;
+        if (c == '\n') {
+            line[lineLen] = 0x00;
+            if (lineLen > 0) execute();
+            lineLen = 0;
+            if (!isOpen) return false;
+            continue;
+        }
+        if (lineLen < SHELL_LINE_LENGTH) line[lineLen++] = c;  // Overlong lines are cut
+    }
+
+    if (millis() - lastInput > SHELL_IDLE_TIMEOUT_MS) {
+        Serial.println("Setup timed out.");
+        close();
+    }
+    return isOpen;
+}
+
+void Shell::execute(void) {
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (commands[i].key == line[0]) {
+            (this->*commands[i].handler)();
+            if (isOpen) Serial.println("READY");
+            return;
+        }
+    }
+    Serial.println("Unknown option.");
+    Serial.println("READY");
+}
+
+void Shell::close(void) {
+    if (settingsChanged) {
+        Serial.println("Writing settings to EEPROM");
+        settings.save();
+        settingsChanged = false;
+    }
+    isOpen = false;
+}
+
+void Shell::help(void) {
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        Serial.print(commands[i].key);
+        Serial.print("  ");
+        Serial.println(commands[i].help);
+    }
+}
+
+void Shell::list(void) {
+    settings.list();
+}
+
+void Shell::set(void) {
+    if (settings.set(line, lineLen)) settingsChanged = true;
+}
+
+void Shell::write(void) {
+    close();
+}
+
+void Shell::dumpLog(void) {
+    uint32_t count = SHELL_DEFAULT_DUMP;
+    if (lineLen > 1) count = strtoul(&line[1], NULL, 10);
+    uint32_t last = Clock.store.nextId;
+    uint32_t first = last > count ? last - count : 0;
+    if (last - first > measurementLog.capacity()) first = last - measurementLog.capacity();
+    dumpRecords(first, last);
+}
+
+void Shell::findLog(void) {
+    char* next = NULL;
+    uint32_t count = SHELL_DEFAULT_DUMP;
+    uint32_t timestamp = strtoul(&line[1], &next, 10);
+    if (next != NULL && *next != 0x00) count = strtoul(next, NULL, 10);
+    uint32_t first = logIndex.find(timestamp);
+    Serial.print("First at or after ");
+    Serial.print(timestamp);
+    Serial.print(": ");
+    Serial.print(first);
+    Serial.print(", ");
+    Serial.print(logIndex.lastReads);
+    Serial.println(" records read");
+    uint32_t last = Clock.store.nextId - first > count ? first + count : Clock.store.nextId;
+    dumpRecords(first, last);
+}
+
+void Shell::dumpRecords(uint32_t first, uint32_t last) {
+    Measurement m;
+    for (uint32_t seq = first; seq < last; seq++) {
+        Serial.print(seq);
+        if (!measurementLog.read(m, seq)) {
+            Serial.println(" unreadable");
+            continue;
+        }
+        Serial.print(" ts=");
+        Serial.print(m.timestamp);
+        Serial.print(" type=");
+        Serial.print(m.type, HEX);
+        Serial.print(" bits=");
+        Serial.print(m.bits);
+        if (m.type == Measurement::TYPE_PWRFAIL) {
+            Serial.print(" pwrfail=");
+            Serial.print(m.powerfail);
+            Serial.print(" pwrback=");
+            Serial.println(m.powerback);
+            continue;
+        }
+        if (m.type == Measurement::TYPE_HEALTH) {
+            Serial.print(" bat=");
+            Serial.print(m.batteryvoltage);
+            for (int f = 0; f < MEASUREMENT_HEALTH_FIELDS; f++) {
+                const Measurement::HealthField& field = Measurement::healthFields[f];
+                Serial.print(' ');
+                Serial.print(field.key);
+                Serial.print('=');
+                if (field.isSigned) {
+                    Serial.print((int32_t)(m.*field.field));
+                } else {
+                    Serial.print(m.*field.field);
+                }
+            }
+            Serial.println();
+            continue;
+        }
+        for (int c = 0; c < MEASUREMENT_CHANNELS; c++) {
+            const Measurement::Channel& channel = Measurement::channels[c];
+            float value = m.*channel.field;
+            if (isnan(value)) continue;
+            Serial.print(' ');
+            Serial.print(channel.key);
+            Serial.print('=');
+            Serial.print(value);
+        }
+        Serial.println();
+        yield();
+    }
+}
+
+void Shell::exportPages(void) {
+    char* next = NULL;
+    uint32_t first = EEPROM_FIRST_SENSORPAGE;
+    uint32_t count = 0;
+    if (lineLen > 1) first = strtoul(&line[1], &next, 10);
+    if (next != NULL && *next != 0x00) count = strtoul(next, NULL, 10);
+    if (count == 0 && first < eepromStore.getMaxPages()) count = eepromStore.getMaxPages() - first;
+    if (!logExport.run(first, count)) Serial.println("Export failed.");
+}
+
+void Shell::stats(void) {
+    Serial.print("Next id:                 ");
+    Serial.println(Clock.store.nextId);
+    Serial.print("Last sent id:            ");
+    Serial.println(Clock.store.lastSentId);
+    Serial.print("Pending records:         ");
+    Serial.println(measurementLog.pending());
+    Serial.print("Log capacity:            ");
+    Serial.println(measurementLog.capacity());
+    Serial.print("Skipped samples:         ");
+    Serial.println(Clock.store.skippedSamples);
+    Serial.print("Radio-free wakes:        ");
+    Serial.println(Clock.store.radioFreeWakes);
+    Serial.print("DNS lookups saved:       ");
+    Serial.println(dnsCache.hits);
+    Serial.print("Alarm/timer wakes:       ");
+    Serial.print(wakeSchedule.alarmWakes);
+    Serial.print("/");
+    Serial.println(wakeSchedule.timerWakes);
+    Serial.print("Last upload:             ");
+    Serial.println(Clock.store.lastUpload);
+    Serial.print("Uptime (ms):             ");
+    Serial.println(millis());
+    Serial.print("Free heap:               ");
+    Serial.println(ESP.getFreeHeap());
+    Serial.print("Log bytes dropped:       ");
+    Serial.println(logSink.dropped);
+}
+
+void Shell::energyReport(void) {
+    Serial.println("ENERGY state s mA mAh");
+    for (int s = 0; s < ENERGY_STATES; s++) {
+        ENERGY_STATE state = (ENERGY_STATE)s;
+        Serial.print(EnergyModel::name(state));
+        Serial.print(" ");
+        Serial.print(energy.us[s] / 1e6, 1);
+        Serial.print(" ");
+        Serial.print(energy.current(state), 2);
+        Serial.print(" ");
+        Serial.println(energy.mAh(state), 3);
+    }
+    Serial.print("mAh/day:                 ");
+    Serial.println(energy.mAhPerDay(), 3);
+    Serial.print("Days on battery:         ");
+    Serial.println(energy.batteryDays(ENERGY_BATTERY_MAH), 0);
+}
+
+#ifndef RELEASE
+void Shell::dumpTrace(void) {
+    trace.dump();
+}
+#endif
+
+Shell shell;
@@ -0,0 +1,421 @@
+#if defined(NATIVE) && !defined(FLEET) && !defined(PIO_UNIT_TESTING)
+// Host simulation runner for the native env, takes the place of main.cpp.
+// Runs the sample, store and upload cycle against the simulated EEPROM and RTCC in virtual time
+// and reports bus usage, awake time and the energy used.
+//
+//     program [days] [-v] [-s <set command>]... [-c <state>=<mA>]... [-b <battery mAh>] [-r <trace.csv>]
+//
+// -s applies a shell set command before the run, "-s si300" samples every 5 minutes.
+// -c overrides the current draw of an energy model state (cpu, radio, eeprom, sensors, sleep).
+// -r replays the samples of a log exported with tools/exportlog.py instead of synthetic values, and compares
+//    the EEPROM writes, uploads and fidelity of the deadband settings with storing every sample.
+#include <Adafruit_MCP23017.h>
+#include <Arduino.h>
+#include <hostsim.h>
+#include <simeeprom.h>
+#include <simrtcc.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "acquisition.h"
+#include "aggregator.h"
+#include "battery.h"
+#include "eepromstore.h"
+#include "energy.h"
+#include "health.h"
+#include "log.h"
+#include "pinout.h"
+#include "rtcc.h"
+#include "settings.h"
+#include "shell.h"
+#include "trace.h"
+#include "uploader.h"
+#include "wakecycle.h"
+#include "wakeschedule.h"
+
+#define SIM_START_TIME 1609459200  // 2021-01-01 00:00:00 UTC
+#define SIM_BATTERY_ADC 640        // About 3.6V through the divider
+#define SIM_WIFI_CONNECT_MS 2000   // Joining the network before an upload
+#define SIM_REQUEST_MS 400         // One upload request over TLS
+#define SIM_WIFI_RSSI -67          // dBm, reported in health records
+#define SIM_WIFI_CHANNEL 6
+#define SIM_MAX_SET_COMMANDS 16
+#define SIM_TRACE_LINE 1024        // Longest CSV line of a replayed trace
+
+Adafruit_MCP23017 ioexpander;
+
+static SimEEPROM eeprom0;
+static SimRTCC rtcc;
+
+// Daily temperature cycle with a little noise
+static float syntheticTemperature(uint32_t t, float base) {
+    return base + 5.0 * sin(2 * M_PI * (t % 86400) / 86400.0) + (rand() % 11 - 5) / 100.0;
+}
+
+// Stands in for the barometer and the first temperature sensor, ready as soon as it is started.
+class SimSensors : public SensorTask {
+   public:
+    bool start(void) override { return true; }
+    bool poll(void) override { return true; }
+    void read(Measurement& m) override {
+        m.barotemp = syntheticTemperature(m.timestamp, 21.0);
+        m.baropress = 1013.0 + (rand() % 21 - 10) / 10.0;
+        m.tempsens0 = syntheticTemperature(m.timestamp, 4.0);
+    }
+};
+
+// Stands in for WiFi and the server: joining takes SIM_WIFI_CONNECT_MS, every upload request is answered
+// with ok after SIM_REQUEST_MS and the network time is the RTCC's.
+class SimRadio : public Radio {
+   public:
+    bool begin(void) override {
+        delay(SIM_WIFI_CONNECT_MS);
+        health.connected(SIM_WIFI_CONNECT_MS, SIM_WIFI_RSSI, SIM_WIFI_CHANNEL);
+        return true;
+    }
+    void end(void) override {}
+    bool registrationNeeded(void) override { return false; }
+    bool registerDevice(void) override { return true; }
+    const uint8_t* signingKey(void) override { return NULL; }
+    time_t getNtpTime(void) override { return rtcc.now(); }
+    bool post(const char* service, const char* body, size_t len, const char* signature, UploadReply& reply) override {
+        delay(SIM_REQUEST_MS);
+        reply.ok = true;
+        return true;
+    }
+};
+
+// One sample of a replayed trace
+struct TraceRow {
+    uint32_t timestamp;
+    uint8_t bits;
+    float values[MEASUREMENT_CHANNELS];  // In Measurement::channels order, NaN where the cell is empty
+};
+
+static std::vector<TraceRow> traceRows;
+static size_t traceRow;
+
+// Reads the values of the trace row being replayed.
+class ReplaySensors : public SensorTask {
+   public:
+    bool start(void) override { return true; }
+    bool poll(void) override { return true; }
+    void read(Measurement& m) override {
+        const TraceRow& row = traceRows[traceRow];
+        m.bits = row.bits;
+        for (int c = 0; c < MEASUREMENT_CHANNELS; c++) m.*Measurement::channels[c].field = row.values[c];
+    }
+};
+
+// What a replay stored and sent, and how far the stored samples held until the next one stray from the trace.
+struct ReplayStats {
+    uint32_t samples;
+    uint32_t stored;
+    uint32_t pageWrites;
+    uint32_t uploads;
+    uint32_t requests;
+    uint32_t bodyBytes;
+    double mAhPerDay;
+    uint32_t compared[CHANNEL_GROUPS];
+    double maxError[CHANNEL_GROUPS];
+    double squaredError[CHANNEL_GROUPS];
+};
+
+static SimSensors simSensors;
+static ReplaySensors replaySensors;
+static SimRadio radio;
+
+// Loads the sample rows of an exportlog.py CSV, columns are found by their header. Returns false if there are none.
+static bool loadTrace(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+    char line[SIM_TRACE_LINE];
+    int typeColumn = -1;
+    int tsColumn = -1;
+    int bitsColumn = -1;
+    int channelColumn[MEASUREMENT_CHANNELS];
+    std::fill(channelColumn, channelColumn + MEASUREMENT_CHANNELS, -1);
+    bool header = true;
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = 0x00;
+        TraceRow row = {};
+        for (int c = 0; c < MEASUREMENT_CHANNELS; c++) row.values[c] = Measurement::NaN();
+        bool sample = false;
+        char* cell = line;
+        for (int column = 0; cell; column++) {
+            char* next = strchr(cell, ',');
+            if (next) *next++ = 0x00;
+            if (header) {
+                if (strcmp(cell, "type") == 0) typeColumn = column;
+                if (strcmp(cell, "ts") == 0) tsColumn = column;
+                if (strcmp(cell, "bits") == 0) bitsColumn = column;
+                for (int c = 0; c < MEASUREMENT_CHANNELS; c++) {
+                    if (strcmp(cell, Measurement::channels[c].key) == 0) channelColumn[c] = column;
+                }
+            } else {
+                if (column == typeColumn) sample = strcmp(cell, "sample") == 0;
+                if (column == tsColumn) row.timestamp = strtoul(cell, NULL, 10);
+                if (column == bitsColumn) row.bits = strtoul(cell, NULL, 10);
+                for (int c = 0; c < MEASUREMENT_CHANNELS; c++) {
+                    if (column == channelColumn[c] && *cell) row.values[c] = atof(cell);
+                }
+            }
+            cell = next;
+        }
+        if (header && (typeColumn < 0 || tsColumn < 0)) break;
+        if (sample) traceRows.push_back(row);
+        header = false;
+    }
+    fclose(in);
+    // The export lists the ring in page order, the oldest record is not necessarily first.
+    std::stable_sort(traceRows.begin(), traceRows.end(),
+                     [](const TraceRow& a, const TraceRow& b) { return a.timestamp < b.timestamp; });
+    if (traceRows.empty()) printf("No samples in %s\n", path);
+    return !traceRows.empty();
+}
+
+// Wakes once per trace row at its timestamp, sleeping in between.
+static void replay(ReplayStats& stats) {
+    float held[MEASUREMENT_CHANNELS];
+    std::fill(held, held + MEASUREMENT_CHANNELS, Measurement::NaN());
+    uint32_t pageWrites = eepromStore.pageWrites;
+    uint32_t requests = uploader.requests;
+    uint32_t bodyBytes = uploader.bodyBytes;
+    stats = {};
+    for (traceRow = 0; traceRow < traceRows.size(); traceRow++) {
+        const TraceRow& row = traceRows[traceRow];
+        time_t now = rtcc.now();
+        if ((time_t)row.timestamp > now) {
+            uint64_t sleepStart = simMicros();
+            delay((row.timestamp - now) * 1000UL);
+            energy.add(ENERGY_SLEEP, simMicros() - sleepStart);
+        }
+        wakeCycle.run(radio);
+        stats.samples++;
+        if (wakeCycle.radioMs > 0) stats.uploads++;
+        if (wakeCycle.change != ChangeFilter::RESULT_SKIP) {
+            stats.stored++;
+            std::copy(row.values, row.values + MEASUREMENT_CHANNELS, held);
+        }
+        for (int c = 0; c < MEASUREMENT_CHANNELS; c++) {
+            if (isnan(row.values[c]) || isnan(held[c])) continue;
+            uint8_t group = Measurement::channels[c].group;
+            double error = fabs(row.values[c] - held[c]);
+            stats.compared[group]++;
+            stats.maxError[group] = std::max(stats.maxError[group], error);
+            stats.squaredError[group] += error * error;
+        }
+    }
+    stats.pageWrites = eepromStore.pageWrites - pageWrites;
+    stats.requests = uploader.requests - requests;
+    stats.bodyBytes = uploader.bodyBytes - bodyBytes;
+    stats.mAhPerDay = energy.mAhPerDay();
+}
+
+static void printReduction(const char* name, double filtered, double baseline) {
+    printf("  %-20s %12.0f %12.0f  %+6.1f%%\n", name, filtered, baseline,
+           baseline > 0 ? (filtered - baseline) * 100 / baseline : 0.0);
+}
+
+// Replays the trace with the settings as they are and, in a forked copy, with every sample stored and no
+// alarms, then compares the two.
+static int replayTrace(const char* path) {
+    int result[2];
+    if (pipe(result) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    ReplayStats baseline = {};
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (int g = 0; g < CHANNEL_GROUPS; g++) {
+            settings.store.deadband[g] = 0;
+            settings.store.alarm[g] = 0;
+        }
+        simSerialEcho(false);
+        replay(baseline);
+        bool sent = write(result[1], &baseline, sizeof(baseline)) == sizeof(baseline);
+        _exit(sent ? 0 : 1);
+    }
+    ReplayStats filtered;
+    replay(filtered);
+    bool received = pid > 0 && read(result[0], &baseline, sizeof(baseline)) == sizeof(baseline);
+    if (pid > 0) waitpid(pid, NULL, 0);
+    close(result[0]);
+    close(result[1]);
+    if (!received) {
+        printf("Baseline replay failed\n");
+        return 1;
+    }
+
+    uint32_t span = traceRows.back().timestamp - traceRows.front().timestamp;
+    printf("Replayed %u samples from %s over %.1f day(s)\n", filtered.samples, path, span / 86400.0);
+    printf("  %-20s %12s %12s\n", "", "filtered", "every sample");
+    printReduction("Samples stored", filtered.stored, baseline.stored);
+    printReduction("EEPROM page writes", filtered.pageWrites, baseline.pageWrites);
+    printReduction("Uploads", filtered.uploads, baseline.uploads);
+    printReduction("Upload requests", filtered.requests, baseline.requests);
+    printReduction("Upload bytes", filtered.bodyBytes, baseline.bodyBytes);
+    printf("  %-20s %12.3f %12.3f\n", "mAh/day", filtered.mAhPerDay, baseline.mAhPerDay);
+    printf("Fidelity, the trace against the last stored sample\n");
+    printf("  %-12s %9s %9s %9s %9s\n", "group", "deadband", "alarm", "max error", "rms error");
+    static const char* const groups[CHANNEL_GROUPS] = {"temperature", "humidity", "pressure", "battery"};
+    for (int g = 0; g < CHANNEL_GROUPS; g++) {
+        if (filtered.compared[g] == 0) continue;
+        printf("  %-12s %9.2f %9.2f %9.3f %9.3f\n", groups[g], settings.store.deadband[g] / 100.0,
+               settings.store.alarm[g] / 100.0, filtered.maxError[g], sqrt(filtered.squaredError[g] / filtered.compared[g]));
+    }
+    return 0;
+}
+
+static bool setCurrent(const char* arg) {
+    const char* value = strchr(arg, '=');
+    if (!value) return false;
+    for (int s = 0; s < ENERGY_STATES; s++) {
+        const char* name = EnergyModel::name((ENERGY_STATE)s);
+        if (strlen(name) == (size_t)(value - arg) && strncasecmp(arg, name, value - arg) == 0) {
+            energy.setCurrent((ENERGY_STATE)s, atof(value + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void boot(SensorTask* sensors) {
+    TRACE_WAKE();
+    TRACE_BEGIN(TRACE_BOOT);
+    Serial.begin(115200);
+    Clock.begin();
+
+    ioexpander.begin();
+    ioexpander.digitalWrite(IOEXP_EEPROM0, HIGH);
+    ioexpander.pinMode(IOEXP_EEPROM0, OUTPUT);
+    ioexpander.pinMode(IOEXP_EXTPOWR, INPUT);
+
+    uint8_t buf[EEPROM_PAGESIZE];
+    TRACE_BEGIN(TRACE_SETTINGS);
+    eepromStore.readPage(buf, EEPROM_SETTINGS_PAGE);
+    bool settingsLoaded = settings.setFromBuf(buf);
+    TRACE_END(TRACE_SETTINGS);
+    if (!settingsLoaded) {
+        settings.copyToBuf(buf);
+        eepromStore.writePage(buf, EEPROM_SETTINGS_PAGE);
+    }
+    eepromStore.updateMaxPages(settings.store.numeeprom * EEPROM_PAGESPERCHIP);
+    eepromStore.setClock(settings.store.spiclock);
+
+    acquisition.add(&battery, "Battery");
+    acquisition.add(sensors, "Sim");
+    aggregator.begin();
+}
+
+int main(int argc, char** argv) {
+    uint32_t days = 1;
+    float batterymAh = ENERGY_BATTERY_MAH;
+    const char* setCommands[SIM_MAX_SET_COMMANDS];
+    int numSetCommands = 0;
+    const char* tracePath = NULL;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-v") == 0) {
+            simSerialEcho(true);
+        } else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc && numSetCommands < SIM_MAX_SET_COMMANDS) {
+            setCommands[numSetCommands++] = argv[++a];
+        } else if (strcmp(argv[a], "-c") == 0 && a + 1 < argc) {
+            if (!setCurrent(argv[++a])) {
+                printf("Unknown energy state in '%s'\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc) {
+            batterymAh = atof(argv[++a]);
+        } else if (strcmp(argv[a], "-r") == 0 && a + 1 < argc) {
+            tracePath = argv[++a];
+        } else {
+            days = atoi(argv[a]);
+        }
+    }
+
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    srand(1);
+    clock_t hostStart = clock();
+    if (tracePath && !loadTrace(tracePath)) return 1;
+
+    simAttachSpiDevice(&eeprom0, IOEXP_EEPROM0);
+    simAttachI2CDevice(&rtcc, SIMRTCC_ADDRESS);
+    simSetAnalog(SIM_BATTERY_ADC);
+    rtcc.start(tracePath ? traceRows.front().timestamp : SIM_START_TIME);
+
+    boot(tracePath ? (SensorTask*)&replaySensors : &simSensors);
+    for (int c = 0; c < numSetCommands; c++) {
+        char line[SHELL_LINE_LENGTH + 1];
+        strncpy(line, setCommands[c], SHELL_LINE_LENGTH);
+        line[SHELL_LINE_LENGTH] = 0x00;
+        if (!settings.set(line, strlen(line))) printf("Setting '%s' not applied\n", setCommands[c]);
+    }
+    if (numSetCommands > 0) settings.save();
+    TRACE_END(TRACE_BOOT);
+    printf("Boot: %.1f ms\n", simMicros() / 1000.0);
+    simResetStats();
+    energy.reset();
+    if (tracePath) return replayTrace(tracePath);
+
+    uint32_t wakes = 0;
+    uint32_t stored = 0;
+    uint32_t uploads = 0;
+    uint32_t healthRecords = 0;
+    uint32_t radioFreeStart = Clock.store.radioFreeWakes;
+    uint32_t offSlot = 0;
+    uint64_t awakeUs = 0;
+    uint64_t maxAwakeUs = 0;
+    time_t end = rtcc.now() + days * 86400;
+
+    while (rtcc.now() < end) {
+        uint32_t firstId = Clock.store.nextId;
+        uint32_t lastHealth = Clock.store.lastHealth;
+
+        wakeCycle.run(radio);
+
+        if (Clock.store.lastHealth != lastHealth) healthRecords++;
+        if (wakeCycle.radioMs > 0) uploads++;
+        awakeUs += wakeCycle.awakeUs;
+        if (wakeCycle.awakeUs > maxAwakeUs) maxAwakeUs = wakeCycle.awakeUs;
+        stored += Clock.store.nextId - firstId;
+        wakes++;
+        if (wakeCycle.sample.timestamp % settings.store.sampleinterval != 0) offSlot++;
+
+        // Sleeps until the RTCC alarm for the next slot pulls the board out of reset.
+        uint64_t sleepStart = simMicros();
+        wakeSchedule.arm(Clock.getTime(), settings.store.sampleinterval);
+        uint64_t alarm = rtcc.alarmMicros();
+        delay(alarm > simMicros() ? (alarm - simMicros() + 999) / 1000 : settings.store.sampleinterval * 1000UL);
+        wakeSchedule.woke(Clock.alarmFired());
+        energy.add(ENERGY_SLEEP, simMicros() - sleepStart);
+    }
+
+    printf("Simulated %u day(s), %u wakes, %u records stored, %u of them health\n", days, wakes, stored, healthRecords);
+    printf("  Awake per wake:     %.2f ms avg, %.2f ms max\n", awakeUs / 1000.0 / wakes, maxAwakeUs / 1000.0);
+    printf("  Uploads:            %u, %u requests\n", uploads, uploader.requests);
+    printf("  Radio-free wakes:   %u\n", Clock.store.radioFreeWakes - radioFreeStart);
+    printf("  Alarm wakes:        %u, %u on the timer, %u samples off their slot\n", wakeSchedule.alarmWakes,
+           wakeSchedule.timerWakes, offSlot);
+    simPrintStats();
+    printf("  Max writes per page: %u\n", eeprom0.maxPageWrites());
+    printf("Energy\n");
+    for (int s = 0; s < ENERGY_STATES; s++) {
+        ENERGY_STATE state = (ENERGY_STATE)s;
+        printf("  %-8s %10.1f s at %6.2f mA = %8.3f mAh\n", EnergyModel::name(state), energy.us[s] / 1e6,
+               energy.current(state), energy.mAh(state));
+    }
+    printf("  %.3f mAh/day, %.0f days on %.0f mAh\n", energy.mAhPerDay(), energy.batteryDays(batterymAh), batterymAh);
+    printf("Host time: %.1f ms\n", (clock() - hostStart) * 1000.0 / CLOCKS_PER_SEC);
+    if (Serial.echo) trace.dump();
+    return 0;
+}
+#endif
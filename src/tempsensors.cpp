@@ -0,0 +1,84 @@
+#include "tempsensors.h"
+
+#include "eepromstore.h"
+
+TempSensors::TempSensors(OneWire& bus) : oneWire(bus) {
+    numSensors = 0;
+    conversionMs = TEMPSENS_CONVERSION_MS;
+    startedAt = 0;
+}
+
+TempSensors::~TempSensors() {}
+
+void TempSensors::setup(uint8_t numSensors, uint8_t resolution) {
+    static_assert(sizeof(addrs) == EEPROM_PAGESIZE, "Tempsens addresses should fill one page.");
+    if (numSensors > TEMPSENS_MAX) numSensors = TEMPSENS_MAX;
+    this->numSensors = 0;
+    if (numSensors == 0) return;
+    if (!eepromStore.readPage((uint8_t*)addrs, EEPROM_TEMPSENS_PAGE)) return;
+    this->numSensors = numSensors;
+
+    // Only the scratchpad is written, it holds until power is lost and setup runs on every boot anyway.
+    if (resolution < 9 || resolution > 12) resolution = 12;
+    conversionMs = TEMPSENS_CONVERSION_MS >> (12 - resolution);
+    if (!oneWire.reset()) return;
+    oneWire.skip();
+    oneWire.write(0x4E);                             // Write Scratchpad
+    oneWire.write(0x4B);                             // TH, alarms are not used, power-on default
+    oneWire.write(0x46);                             // TL, power-on default
+    oneWire.write(((resolution - 9) << 5) | 0x1F);  // Config, DS18S20 ignores it
+}
+
+bool TempSensors::start(void) {
+    if (numSensors == 0) return false;
+    if (!oneWire.reset()) return false;
+    oneWire.skip();
+    oneWire.write(0x44, 1);  // start conversion on all sensors, with parasite power on at the end
+    startedAt = millis();
+    return true;
+}
+
+bool TempSensors::poll(void) {
+    // Parasite powered sensors can't signal completion, so go by the worst case conversion time.
+    return millis() - startedAt >= conversionMs;
+}
+
+void TempSensors::read(Measurement& m) {
+    float* tempsens = &m.tempsens0;  // tempsens0..7 are consecutive
+    for (uint8_t s = 0; s < numSensors; s++) {
+        tempsens[s] = readSensor(addrs[s]);
+    }
+}
+
+float TempSensors::readSensor(uint8_t* addr) {
+    uint8_t data[9];
+
+    if (OneWire::crc8(addr, 7) != addr[7]) return Measurement::NaN();
+    if (!oneWire.reset()) return Measurement::NaN();
+    oneWire.select(addr);
+    oneWire.write(0xBE);  // Read Scratchpad
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        data[i] = oneWire.read();
+    }
+    if (OneWire::crc8(data, 8) != data[8]) return Measurement::NaN();
+
+    int16_t raw = (data[1] << 8) | data[0];
+    if (addr[0] == 0x10) {
+        // DS18S20 or old DS1820
+        raw = raw << 3;  // 9 bit resolution default
+        if (data[7] == 0x10) {
+            // "count remain" gives full 12 bit resolution
+            raw = (raw & 0xFFF0) + 12 - data[6];
+        }
+    } else {
+        uint8_t cfg = (data[4] & 0x60);
+        // at lower res, the low bits are undefined, so let's zero them
+        if (cfg == 0x00)
+            raw = raw & ~7;  // 9 bit resolution
+        else if (cfg == 0x20)
+            raw = raw & ~3;  // 10 bit res
+        else if (cfg == 0x40)
+            raw = raw & ~1;  // 11 bit res
+    }
+    return (float)raw / 16.0;
+}
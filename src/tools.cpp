@@ -30,4 +30,5 @@ bool updateCrcBuf(uint8_t* buf, size_t bufSize) {
     uint32_t newCrc = 0;
     newCrc = CRC32::calculate(buf, bufSize - sizeof(newCrc));
     memcpy(&buf[bufSize - sizeof(newCrc)], (uint8_t*)&newCrc, sizeof(newCrc));
+    return true;
 }
@@ -0,0 +1,70 @@
+#include "trace.h"
+
+#include <Arduino.h>
+
+#include "rtcmem.h"
+#include "tools.h"
+
+static const char* phaseNames[TRACE_PHASES] = {"RTCC", "Settings", "Sensors", "Append", "WiFi", "TLS", "Upload", "Boot"};
+
+TraceBuffer::TraceBuffer() {}
+
+TraceBuffer::~TraceBuffer() {}
+
+Trace::Trace() {}
+
+Trace::~Trace() {}
+
+void Trace::begin(void) {
+    static_assert(sizeof(TraceBuffer) % RTCMEM_BLOCKSIZE == 0, "TraceBuffer must fill whole blocks.");
+    static_assert(RTCMEM_TRACE_BLOCK + sizeof(TraceBuffer) / RTCMEM_BLOCKSIZE <= RTCMEM_BLOCKS, "TraceBuffer does not fit in RTC memory.");
+    ESP.rtcUserMemoryRead(RTCMEM_TRACE_BLOCK, (uint32_t*)&buffer, sizeof(buffer));
+    if (!checkCrcBuf((uint8_t*)&buffer, sizeof(buffer)) || buffer.head >= TRACE_ENTRIES || buffer.used > TRACE_ENTRIES) {
+        memset((uint8_t*)&buffer, 0, sizeof(buffer));
+    }
+    buffer.wake++;
+}
+
+void Trace::mark(TRACE_PHASE phase, uint8_t flags) {
+    TraceEntry& e = buffer.entries[buffer.head];
+    e.micros = micros();
+    e.wake = buffer.wake;
+    e.phase = phase;
+    e.flags = flags;
+    buffer.head = (buffer.head + 1) % TRACE_ENTRIES;
+    if (buffer.used < TRACE_ENTRIES) buffer.used++;
+}
+
+void Trace::save(void) {
+    updateCrcBuf((uint8_t*)&buffer, sizeof(buffer));
+    ESP.rtcUserMemoryWrite(RTCMEM_TRACE_BLOCK, (uint32_t*)&buffer, sizeof(buffer));
+}
+
+void Trace::clear(void) {
+    buffer.head = 0;
+    buffer.used = 0;
+}
+
+uint8_t Trace::count(void) {
+    return buffer.used;
+}
+
+TraceEntry& Trace::entry(uint8_t n) {
+    uint8_t first = (buffer.head + TRACE_ENTRIES - buffer.used) % TRACE_ENTRIES;
+    return buffer.entries[(first + n) % TRACE_ENTRIES];
+}
+
+void Trace::dump(void) {
+    Serial.println("TRACE wake us phase");
+    for (uint8_t n = 0; n < count(); n++) {
+        TraceEntry& e = entry(n);
+        Serial.print(e.wake);
+        Serial.print(" ");
+        Serial.print(e.micros);
+        Serial.print(" ");
+        Serial.print(e.phase < TRACE_PHASES ? phaseNames[e.phase] : "?");
+        Serial.println(e.flags & TRACE_FLAG_END ? " end" : " begin");
+    }
+}
+
+Trace trace;
@@ -0,0 +1,314 @@
+#include "uploader.h"
+
+#include <Arduino.h>
+#include <ctype.h>
+#include <math.h>
+#include <new>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "hmac.h"
+#include "log.h"
+#include "measurementlog.h"
+#include "rtcc.h"
+#include "settings.h"
+#include "trace.h"
+
+#define UPLOAD_FLOAT_DECIMALS 4
+
+// Writes the request body into a fixed buffer and feeds the same bytes to the HMAC, so signing needs no second pass.
+class BodyWriter : public Print {
+   public:
+    BodyWriter(char* buf, size_t size, HmacSha256* mac) : buf(buf), size(size), len(0), mac(mac) {}
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t* data, size_t n) override {
+        if (n > size - len) n = size - len;  // Only if UPLOAD_RECORD_MAX or UPLOAD_TAIL_MAX is too small
+        memcpy(&buf[len], data, n);
+        len += n;
+        if (mac) mac->update(data, n);
+        return n;
+    }
+    using Print::write;
+    size_t length(void) { return len; }
+    size_t remaining(void) { return size - len; }
+
+   private:
+    char* buf;
+    size_t size;
+    size_t len;
+    HmacSha256* mac;
+};
+
+// Fixed point with trailing zeros cut, shorter than the float printing of Print and JSON libraries.
+static void writeFloat(Print& out, float value) {
+    const uint32_t scale = 10000;  // 10^UPLOAD_FLOAT_DECIMALS
+    double scaled = round(fabs((double)value) * scale);
+    if (value < 0 && scaled > 0) out.print('-');
+    out.print((unsigned long)(scaled / scale));
+    uint32_t frac = (uint32_t)fmod(scaled, scale);
+    if (frac == 0) return;
+    char digits[UPLOAD_FLOAT_DECIMALS + 2] = ".";
+    for (int i = UPLOAD_FLOAT_DECIMALS; i > 0; i--, frac /= 10) digits[i] = '0' + frac % 10;
+    size_t len = UPLOAD_FLOAT_DECIMALS + 1;
+    while (digits[len - 1] == '0') len--;
+    out.write((const uint8_t*)digits, len);
+}
+
+// Writes the separator and a key, separator is '{' for the first member of an object and ',' for the others.
+static void writeKey(Print& out, char separator, const char* key) {
+    out.print(separator);
+    out.print('"');
+    out.print(key);
+    out.print("\":");
+}
+
+static void writeRecord(Print& out, Measurement& m) {
+    writeKey(out, '{', "id");
+    out.print(m.id);
+    writeKey(out, ',', "type");
+    out.print((uint8_t)m.type);
+    writeKey(out, ',', "bits");
+    out.print(m.bits);
+    writeKey(out, ',', "ts");
+    out.print(m.timestamp);
+    if (m.type == Measurement::TYPE_PWRFAIL) {
+        writeKey(out, ',', "pwrfail");
+        out.print(m.powerfail);
+        writeKey(out, ',', "pwrback");
+        out.print(m.powerback);
+        out.print('}');
+        return;
+    }
+    if (m.type == Measurement::TYPE_HEALTH) {
+        if (isfinite(m.batteryvoltage)) {
+            writeKey(out, ',', "bat");
+            writeFloat(out, m.batteryvoltage);
+        }
+        for (int f = 0; f < MEASUREMENT_HEALTH_FIELDS; f++) {
+            const Measurement::HealthField& field = Measurement::healthFields[f];
+            writeKey(out, ',', field.key);
+            if (field.isSigned) {
+                out.print((int32_t)(m.*field.field));
+            } else {
+                out.print(m.*field.field);
+            }
+        }
+        out.print('}');
+        return;
+    }
+    // Fields without a reading are left out instead of sent as NaN.
+    for (int c = 0; c < MEASUREMENT_CHANNELS; c++) {
+        const Measurement::Channel& channel = Measurement::channels[c];
+        float value = m.*channel.field;
+        if (!isfinite(value)) continue;
+        writeKey(out, ',', channel.key);
+        writeFloat(out, value);
+    }
+    out.print('}');
+}
+
+// Writes one request for the records from first on, returns the sequence number of the last one.
+static uint32_t writeBody(BodyWriter& out, uint32_t first, bool withTrace) {
+    Measurement m;
+    writeKey(out, '{', "serial");
+    out.print(settings.store.serialno);
+#ifndef RELEASE
+    // Phase markers from previous wakes ride along with the first request as diagnostics.
+    if (withTrace) {
+        writeKey(out, ',', "trace");
+        out.print('[');
+        for (uint8_t n = 0; n < trace.count(); n++) {
+            TraceEntry& e = trace.entry(n);
+            out.print(n ? ",[" : "[");
+            out.print(e.wake);
+            out.print(',');
+            out.print((uint8_t)e.phase);
+            out.print(',');
+            out.print(e.flags);
+            out.print(',');
+            out.print(e.micros);
+            out.print(']');
+        }
+        out.print(']');
+    }
+#endif
+    writeKey(out, ',', "measurements");
+    out.print('[');
+    uint32_t seq = first;
+    bool separator = false;
+    for (int n = 0; n < UPLOAD_RECORDS_PER_REQUEST && seq < Clock.store.nextId &&
+                    out.remaining() >= UPLOAD_RECORD_MAX + UPLOAD_TAIL_MAX;
+         n++, seq++) {
+        if (!measurementLog.read(m, seq)) {
+            LogError::print("Skipping unreadable record ");
+            LogError::println(seq);
+            continue;
+        }
+        if (separator) out.print(',');
+        writeRecord(out, m);
+        separator = true;
+    }
+    uint32_t last = seq - 1;
+    out.print(']');
+    writeKey(out, ',', "first");
+    out.print(first);
+    writeKey(out, ',', "last");
+    out.print(last);
+    writeKey(out, ',', "cfgver");
+    out.print(settings.store.configversion);
+    out.print('}');
+    return last;
+}
+
+// Writes one binary batch for the records from first on, returns the sequence number of the last one.
+static uint32_t writeBatch(BodyWriter& out, uint32_t first, bool sign) {
+    static_assert(sizeof(UploadBatchHeader) == 20, "UploadBatchHeader has wrong size.");
+    uint32_t end = first + UPLOAD_RECORDS_PER_REQUEST;
+    if (end > Clock.store.nextId) end = Clock.store.nextId;
+    UploadBatchHeader header;
+    header.magic = UPLOAD_BATCH_MAGIC;
+    header.version = UPLOAD_BATCH_VERSION;
+    header.flags = sign ? UPLOAD_FLAG_SIGNED : 0;
+    header.serial = settings.store.serialno;
+    header.first = first;
+    header.last = end - 1;
+    header.cfgver = settings.store.configversion;
+    out.write((const uint8_t*)&header, sizeof(header));
+
+    Measurement m;
+    for (uint32_t seq = first; seq < end; seq++) {
+        if (!measurementLog.read(m, seq)) {
+            LogError::print("Skipping unreadable record ");
+            LogError::println(seq);
+            continue;
+        }
+        out.write((const uint8_t*)&m, sizeof(m));
+    }
+    return end - 1;
+}
+
+Uploader::Uploader() {
+    requests = 0;
+    bodyBytes = 0;
+}
+
+Uploader::~Uploader() {}
+
+/* Upload protocol
+   Each request carries a batch of consecutive records, "first" and "last" are the sequence numbers of its ends.
+   Records carry the low 16 bits of their sequence number as "id".
+   The server answers {"status":"ok","ack":<seq>} where ack is the highest sequence number it has stored durably,
+   it may also send an ack with a failed status when only part of a batch was stored. Sending resumes right
+   after the ack, so after a failure only the unacknowledged tail is sent again. A batch may be sent again if
+   its reply was lost, the server has to ignore records at or below its ack.
+   Requests also carry "cfgver", the version of the last remote config applied. When the server has a newer one
+   it adds "config" and "cfgver" to the reply, otherwise nothing, see applyConfig in communication.cpp.
+   The body is signed with HMAC-SHA256 keyed with the 64 byte device token page, sent hex encoded in the
+   X-Signature header. Replays are harmless as records at or below the ack are ignored.
+   The server signs its reply to a signed request the same way, over the request's X-Signature followed by the
+   JSON line. Over plain http the device takes neither ack nor config from a reply without it, see checkReply.
+*/
+bool Uploader::run(UploadTransport& transport, const uint8_t* key, size_t keyLen) {
+    // The whole batch is buffered because its signature goes out in the X-Signature header, ahead of the body.
+    char* body = new (std::nothrow) char[UPLOAD_BODY_SIZE + 1];
+    if (!body) {
+        LogError::println("No memory for the upload body");
+        return false;
+    }
+    bool ok = true;
+#ifndef RELEASE
+    bool withTrace = !transport.binary() && trace.count() > 0;
+#else
+    bool withTrace = false;
+#endif
+
+    TRACE_BEGIN(TRACE_UPLOAD);
+    while (ok && measurementLog.pending() > 0) {
+        HmacSha256 mac;
+        if (key) mac.begin(key, keyLen);
+        BodyWriter out(body, UPLOAD_BODY_SIZE, key ? &mac : NULL);
+        uint32_t first = Clock.store.lastSentId;
+        uint32_t last = transport.binary() ? writeBatch(out, first, key != NULL) : writeBody(out, first, withTrace);
+        body[out.length()] = 0x00;
+
+        char signature[2 * SHA256_DIGEST_SIZE + 1] = "";
+        if (key) {
+            uint8_t digest[SHA256_DIGEST_SIZE];
+            mac.finish(digest);
+            for (int i = 0; i < SHA256_DIGEST_SIZE; i++) sprintf(&signature[2 * i], "%02x", digest[i]);
+        }
+        requests++;
+        bodyBytes += out.length();
+        UploadReply reply = {false, false, 0};
+        bool answered = transport.post("upload", body, out.length(), key ? signature : NULL, reply);
+        ok = answered && reply.ok;
+        // Servers without acknowledgements store whole batches.
+        uint32_t ack = ok ? last : first - 1;
+        if (answered && reply.hasAck) ack = reply.ack;
+        if (!measurementLog.acknowledge(ack)) {
+            LogError::print("Bad upload ack: ");
+            LogError::println(ack);
+            ok = false;
+        }
+        if (!ok) break;
+#ifndef RELEASE
+        if (withTrace) {
+            withTrace = false;
+            trace.clear();
+        }
+#endif
+        Clock.store.lastUpload = Clock.getTime();
+        Clock.saveStore();
+        // A server acking less than it was sent would otherwise be asked for the same batch forever.
+        if (Clock.store.lastSentId <= first) ok = false;
+    }
+    TRACE_END(TRACE_UPLOAD);
+    delete[] body;
+    return ok;
+}
+
+bool Uploader::parseAck(const uint8_t* buf, size_t len, const char* body, const uint8_t* key, size_t keyLen, UploadReply& reply) {
+    static_assert(sizeof(UploadAck) == 24, "UploadAck has wrong size.");
+    UploadAck ack;
+    UploadBatchHeader header;
+    if (len != sizeof(ack)) return false;
+    memcpy(&ack, buf, sizeof(ack));
+    memcpy(&header, body, sizeof(header));
+    if (ack.magic != UPLOAD_ACK_MAGIC || ack.version != UPLOAD_BATCH_VERSION || ack.serial != header.serial || ack.first != header.first) {
+        return false;
+    }
+    if (key) {
+        HmacSha256 mac;
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        mac.begin(key, keyLen);
+        mac.update(buf, offsetof(UploadAck, mac));
+        mac.finish(digest);
+        uint8_t diff = 0;
+        for (int i = 0; i < UPLOAD_ACK_MAC_SIZE; i++) diff |= digest[i] ^ ack.mac[i];
+        if (diff) return false;
+    }
+    reply.ok = ack.status == UPLOAD_ACK_OK;
+    reply.hasAck = true;
+    reply.ack = ack.ack;
+    return true;
+}
+
+bool Uploader::checkReply(const char* reply, size_t len, const char* signature, const char* replySignature, const uint8_t* key,
+                          size_t keyLen) {
+    if (!replySignature || strlen(replySignature) != 2 * SHA256_DIGEST_SIZE) return false;
+    HmacSha256 mac;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    mac.begin(key, keyLen);
+    mac.update((const uint8_t*)signature, 2 * SHA256_DIGEST_SIZE);
+    mac.update((const uint8_t*)reply, len);
+    mac.finish(digest);
+    char expected[2 * SHA256_DIGEST_SIZE + 1];
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) sprintf(&expected[2 * i], "%02x", digest[i]);
+    uint8_t diff = 0;
+    for (int i = 0; i < 2 * SHA256_DIGEST_SIZE; i++) diff |= expected[i] ^ tolower(replySignature[i]);
+    return diff == 0;
+}
+
+Uploader uploader;
@@ -0,0 +1,81 @@
+#include "uploadpolicy.h"
+
+#include <Arduino.h>
+
+#include "log.h"
+#include "measurementlog.h"
+#include "rtcc.h"
+#include "settings.h"
+
+UploadPolicy::UploadPolicy() {}
+
+UploadPolicy::~UploadPolicy() {}
+
+bool UploadPolicy::uploadDue(time_t now, bool extPower) {
+    uint32_t pending = measurementLog.pending();
+    if (pending == 0) return false;
+    if (extPower) return pending >= UPLOAD_EXTPOWER_BATCHSIZE;
+
+    if (pending >= settings.store.batchsize) return true;
+    return now - Clock.store.lastUpload >= (time_t)settings.store.uploadinterval * 60;
+}
+
+bool UploadPolicy::attemptAllowed(time_t now, bool extPower) {
+    if (Clock.store.uploadFailures > 0 && (uint32_t)now < Clock.store.nextUploadAttempt) return false;
+    if (extPower) return true;
+    if (Clock.store.radioDay != (uint32_t)now / 86400) return true;
+    return Clock.store.radioMsToday < settings.store.radiobudget * 1000UL;
+}
+
+void UploadPolicy::attemptDone(time_t now, bool success, bool progress, uint32_t radioMs) {
+    if (success) {
+        Clock.store.uploadFailures = 0;
+    } else {
+        // Otherwise a backlog sent in several batches, each of which may fail, backs off ever longer while it
+        // shrinks, until the log wraps and overwrites unsent records.
+        if (progress) Clock.store.uploadFailures = 0;
+        Clock.store.uploadFailures++;
+        uint32_t wait = backoff(Clock.store.uploadFailures);
+        // Try again before the log wraps, even at the fastest store rate of one record per sample.
+        uint32_t room = (measurementLog.capacity() - measurementLog.pending()) * settings.store.sampleinterval / 2;
+        if (wait > room) wait = room;
+        Clock.store.nextUploadAttempt = now + wait;
+        LogInfo::print("Upload failed, next attempt at ");
+        LogInfo::println(Clock.store.nextUploadAttempt);
+    }
+    chargeRadio(now, radioMs);
+}
+
+void UploadPolicy::chargeRadio(time_t now, uint32_t radioMs) {
+    uint32_t day = now / 86400;
+    if (Clock.store.radioDay != day) {
+        Clock.store.radioDay = day;
+        Clock.store.radioMsToday = 0;
+    }
+    Clock.store.radioMsToday += radioMs;
+    Clock.saveStore();
+}
+
+void UploadPolicy::wakeDone(uint32_t radioMs) {
+    if (radioMs == 0) Clock.store.radioFreeWakes++;
+}
+
+bool UploadPolicy::clockCheckDue(time_t now) {
+    return (uint32_t)now >= Clock.store.nextNTPcheck;
+}
+
+void UploadPolicy::clockChecked(time_t now) {
+    Clock.store.lastNTPcheck = now;
+    Clock.store.nextNTPcheck = now + NTP_CHECK_INTERVAL;
+    Clock.saveStore();
+}
+
+uint32_t UploadPolicy::backoff(uint32_t failures) {
+    uint32_t wait = UPLOAD_BACKOFF_MAX;
+    if (failures < 16) wait = (uint32_t)UPLOAD_BACKOFF_BASE << (failures - 1);
+    if (wait > UPLOAD_BACKOFF_MAX) wait = UPLOAD_BACKOFF_MAX;
+    // Half fixed, half random, so devices that lost the server together don't come back together.
+    return wait / 2 + ESP.random() % (wait / 2 + 1);
+}
+
+UploadPolicy uploadPolicy;
@@ -0,0 +1,96 @@
+#include "wakecycle.h"
+
+#include <Arduino.h>
+
+#include "acquisition.h"
+#include "aggregator.h"
+#include "battery.h"
+#include "eepromstore.h"
+#include "energy.h"
+#include "health.h"
+#include "log.h"
+#include "measurementlog.h"
+#include "rtcc.h"
+#include "settings.h"
+#include "trace.h"
+#include "uploadpolicy.h"
+
+WakeCycle::WakeCycle() {
+    change = ChangeFilter::RESULT_SKIP;
+    radioMs = 0;
+    awakeUs = 0;
+}
+
+WakeCycle::~WakeCycle() {}
+
+void WakeCycle::run(Radio& radio) {
+    LogDebug::print("#");
+    uint32_t wakeStart = micros();
+    sample = Measurement();
+    sample.timestamp = Clock.getTime();
+    acquisition.run(sample);
+    acquisition.printTiming();
+    health.sensorsDone(acquisition.timing);
+    aggregator.add(sample);
+
+    change = ChangeFilter::RESULT_SKIP;
+    if (settings.store.aggregatewindow == 0 || settings.store.aggregatemode != AGGREGATE_ONLY) {
+        change = changeFilter.check(sample);
+        if (change != ChangeFilter::RESULT_SKIP && !measurementLog.append(sample)) {
+            LogError::println("Failed to store measurement");
+        }
+    }
+    // Before the upload check, so a health record that falls due goes out with this wake's upload.
+    if (health.due(sample.timestamp)) health.record(sample);
+
+    radioMs = 0;
+    if (change == ChangeFilter::RESULT_ALARM || uploadPolicy.uploadDue(sample.timestamp, battery.extPower)) {
+        radioMs = connectAndUpload(radio, sample.timestamp);
+    }
+    uploadPolicy.wakeDone(radioMs);
+
+    logSink.drain();
+    TRACE_SAVE();
+    // Wake phases measured with micros(), the wait for the next sample is counted as sleep by the caller.
+    awakeUs = micros() - wakeStart;
+    energy.addWake(awakeUs, radioMs);
+    health.wakeDone(awakeUs / 1000);
+}
+
+void WakeCycle::syncClock(Radio& radio) {
+    time_t ntpnow = radio.getNtpTime();
+    if (ntpnow == 0) {
+        LogError::println("No NTP time, keeping RTC time.");
+        return;
+    }
+    if (!Clock.running) {
+        Clock.setTime(ntpnow);
+    } else {
+        time_t rtcNow = Clock.getTime();
+        int delta = ntpnow - rtcNow;
+        LogDebug::print("RTC NTP Delta: ");
+        LogDebug::println(delta);
+        LogDebug::print("RTC TIME: ");
+        LogDebug::println(rtcNow);
+        if (delta > 3600 || delta < -3600) Clock.setTime(ntpnow);
+    }
+    uploadPolicy.clockChecked(ntpnow);
+}
+
+// Registers if needed and uploads, unless the retry policy says to wait.
+// Returns the radio time spent, 0 if no attempt was made.
+uint32_t WakeCycle::connectAndUpload(Radio& radio, time_t now) {
+    if (!uploadPolicy.attemptAllowed(now, battery.extPower)) return 0;
+    uint32_t radioStart = millis();
+    uint32_t sentBefore = Clock.store.lastSentId;
+    bool ok = radio.begin();
+    if (ok && !settings.registered && radio.registrationNeeded()) ok = radio.registerDevice();
+    if (ok) ok = uploader.run(radio, radio.signingKey(), EEPROM_PAGESIZE);
+    if (ok && uploadPolicy.clockCheckDue(now)) syncClock(radio);
+    radio.end();
+    uint32_t ms = millis() - radioStart;
+    uploadPolicy.attemptDone(now, ok, Clock.store.lastSentId != sentBefore, ms);
+    return ms;
+}
+
+WakeCycle wakeCycle;
@@ -0,0 +1,36 @@
+#include "wakeschedule.h"
+
+#include "log.h"
+#include "rtcc.h"
+
+WakeSchedule::WakeSchedule() {
+    alarmWakes = 0;
+    timerWakes = 0;
+}
+
+WakeSchedule::~WakeSchedule() {}
+
+time_t WakeSchedule::nextSlot(time_t now, uint32_t interval) {
+    if (interval == 0) interval = 1;
+    time_t midnight = now - now % 86400;
+    time_t slot = midnight + ((now - midnight) / interval + 1) * interval;
+    return slot < midnight + 86400 ? slot : midnight + 86400;
+}
+
+time_t WakeSchedule::arm(time_t now, uint32_t interval) {
+    time_t slot = nextSlot(now, interval);
+    Clock.setAlarm(slot);
+    return slot;
+}
+
+void WakeSchedule::woke(bool byAlarm) {
+    if (byAlarm) {
+        alarmWakes++;
+    } else {
+        timerWakes++;
+        LogError::println("No RTCC alarm, woke on the timer");
+    }
+    Clock.clearAlarm();
+}
+
+WakeSchedule wakeSchedule;
@@ -0,0 +1,145 @@
+// Summaries from Aggregator against min/max/mean computed directly from the same series.
+#include <Adafruit_MCP23017.h>
+#include <Arduino.h>
+#include <hostsim.h>
+#include <math.h>
+#include <simeeprom.h>
+#include <simrtcc.h>
+#include <unity.h>
+
+#include "aggregator.h"
+#include "eepromstore.h"
+#include "measurementlog.h"
+#include "pinout.h"
+#include "rtcc.h"
+#include "rtcmem.h"
+#include "settings.h"
+
+#define START_TIME 1609459200  // 2021-01-01 00:00:00 UTC, a window boundary
+#define WINDOW_MIN 15
+#define INTERVAL 60
+#define WINDOWS 4
+
+Adafruit_MCP23017 ioexpander;
+
+static SimEEPROM eeprom0;
+static SimRTCC rtcc;
+
+// Sample n of the series, humidity drops out for a few samples and the barometer is missing.
+static void sample(Measurement& m, int n) {
+    m.timestamp = START_TIME + n * INTERVAL;
+    m.batteryvoltage = 3.7 - n * 0.001;
+    m.tempsens0 = 4.0 + 3.0 * sin(n * 0.3) + (n % 7) * 0.01;
+    m.humidity = (n % 15 >= 5 && n % 15 < 8) ? Measurement::NaN() : 55.0 + (n % 11) * 0.7;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_summaries_match_offline(void) {
+    const int samples = WINDOWS * WINDOW_MIN * 60 / INTERVAL;
+    uint32_t first = Clock.store.nextId;
+
+    // Every sample is its own wake: a fresh Aggregator that only has what RTC memory kept.
+    for (int n = 0; n <= samples; n++) {
+        Measurement m;
+        sample(m, n);
+        Aggregator wake;
+        wake.begin();
+        wake.add(m);
+    }
+
+    // Sample number samples starts window WINDOWS + 1, which emits window WINDOWS.
+    TEST_ASSERT_EQUAL(first + WINDOWS * 3, Clock.store.nextId);
+    const int perWindow = WINDOW_MIN * 60 / INTERVAL;
+    for (int w = 0; w < WINDOWS; w++) {
+        Measurement summary[3];
+        for (int k = 0; k < 3; k++) TEST_ASSERT_TRUE(measurementLog.read(summary[k], first + w * 3 + k));
+        TEST_ASSERT_EQUAL(Measurement::TYPE_SUMMARY_MIN, summary[0].type);
+        TEST_ASSERT_EQUAL(Measurement::TYPE_SUMMARY_MAX, summary[1].type);
+        TEST_ASSERT_EQUAL(Measurement::TYPE_SUMMARY_MEAN, summary[2].type);
+
+        for (int c = 0; c < MEASUREMENT_CHANNELS; c++) {
+            float Measurement::*field = Measurement::channels[c].field;
+            double low = INFINITY, high = -INFINITY, sum = 0;
+            int count = 0;
+            for (int n = w * perWindow; n < (w + 1) * perWindow; n++) {
+                Measurement m;
+                sample(m, n);
+                float value = m.*field;
+                if (isnan(value)) continue;
+                low = fmin(low, value);
+                high = fmax(high, value);
+                sum += value;
+                count++;
+            }
+            for (int k = 0; k < 3; k++) {
+                TEST_ASSERT_EQUAL_UINT32(START_TIME + w * WINDOW_MIN * 60, summary[k].timestamp);
+                TEST_ASSERT_EQUAL(perWindow, summary[k].bits);
+                if (count == 0) TEST_ASSERT_TRUE_MESSAGE(isnan(summary[k].*field), Measurement::channels[c].key);
+            }
+            if (count == 0) continue;
+            TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0, low, summary[0].*field, Measurement::channels[c].key);
+            TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0, high, summary[1].*field, Measurement::channels[c].key);
+            TEST_ASSERT_FLOAT_WITHIN_MESSAGE(1e-5 * fabs(sum / count), sum / count, summary[2].*field,
+                                             Measurement::channels[c].key);
+        }
+    }
+}
+
+// A wake that finds the RTC memory state corrupt starts a new window instead of summarizing garbage.
+void test_corrupt_state_restarts_window(void) {
+    Measurement m;
+    sample(m, 0);
+    m.timestamp += 86400;
+    Aggregator wake;
+    wake.begin();
+    wake.add(m);  // Summarizes what the previous test left open
+    uint32_t first = Clock.store.nextId;
+
+    uint32_t garbage[4] = {0xdeadbeef, 1, 2, 3};
+    ESP.rtcUserMemoryWrite(RTCMEM_AGGREGATE_BLOCK, garbage, sizeof(garbage));
+    Aggregator next;
+    next.begin();
+    m.timestamp += WINDOW_MIN * 60;
+    next.add(m);
+    TEST_ASSERT_EQUAL(first, Clock.store.nextId);
+}
+
+// Summary records count samples in 8 bits, the shell refuses windows and intervals that would overflow it.
+void test_window_limited_to_255_samples(void) {
+    SettingsStorage saved = settings.store;
+    char fits[] = "sg255";
+    char tooLong[] = "sg256";
+    char tooShort[] = "si59";
+    settings.store.sampleinterval = 60;
+    TEST_ASSERT_TRUE(settings.set(fits, strlen(fits)));
+    TEST_ASSERT_EQUAL(255, settings.store.aggregatewindow);
+    settings.set(tooLong, strlen(tooLong));
+    TEST_ASSERT_EQUAL(255, settings.store.aggregatewindow);
+    settings.set(tooShort, strlen(tooShort));
+    TEST_ASSERT_EQUAL(60, settings.store.sampleinterval);
+    settings.store = saved;
+}
+
+int main(int argc, char** argv) {
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    simAttachSpiDevice(&eeprom0, IOEXP_EEPROM0);
+    simAttachI2CDevice(&rtcc, SIMRTCC_ADDRESS);
+    rtcc.start(START_TIME);
+    Clock.begin();
+    ioexpander.begin();
+    ioexpander.digitalWrite(IOEXP_EEPROM0, HIGH);
+    ioexpander.pinMode(IOEXP_EEPROM0, OUTPUT);
+    eepromStore.updateMaxPages(EEPROM_PAGESPERCHIP);
+    eepromStore.setClock(0);
+    settings.store.aggregatewindow = WINDOW_MIN;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_summaries_match_offline);
+    RUN_TEST(test_corrupt_state_restarts_window);
+    RUN_TEST(test_window_limited_to_255_samples);
+    return UNITY_END();
+}
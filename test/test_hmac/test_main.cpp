@@ -0,0 +1,133 @@
+// HMAC-SHA256 against the RFC 4231 test cases, fed through the incremental API in uneven pieces,
+// and the upload reply signatures built on it.
+#include <Adafruit_MCP23017.h>
+#include <string.h>
+#include <unity.h>
+
+#include "hmac.h"
+#include "uploader.h"
+
+Adafruit_MCP23017 ioexpander;
+
+struct HmacCase {
+    uint8_t keyByte;  // The RFC keys are one repeated byte, except case 2
+    size_t keyLen;
+    const char* key;  // Used instead of keyByte if set
+    const char* data;
+    uint8_t mac[SHA256_DIGEST_SIZE];
+};
+
+static const HmacCase cases[] = {
+    // Case 1
+    {0x0b, 20, NULL, "Hi There",
+     {0xb0, 0x34, 0x4c, 0x61, 0xd8, 0xdb, 0x38, 0x53, 0x5c, 0xa8, 0xaf, 0xce, 0xaf, 0x0b, 0xf1, 0x2b,
+      0x88, 0x1d, 0xc2, 0x00, 0xc9, 0x83, 0x3d, 0xa7, 0x26, 0xe9, 0x37, 0x6c, 0x2e, 0x32, 0xcf, 0xf7}},
+    // Case 2, key shorter than the digest
+    {0, 4, "Jefe", "what do ya want for nothing?",
+     {0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+      0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43}},
+    // Case 6, key longer than a block
+    {0xaa, 131, NULL, "Test Using Larger Than Block-Size Key - Hash Key First",
+     {0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+      0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54}},
+    // Case 7, key and data longer than a block
+    {0xaa, 131, NULL,
+     "This is a test using a larger than block-size key and a larger than block-size data. "
+     "The key needs to be hashed before being used by the HMAC algorithm.",
+     {0x9b, 0x09, 0xff, 0xa7, 0x1b, 0x94, 0x2f, 0xcb, 0x27, 0x63, 0x5f, 0xbc, 0xd5, 0xb0, 0xe9, 0x44,
+      0xbf, 0xdc, 0x63, 0x64, 0x4f, 0x07, 0x13, 0x93, 0x8a, 0x7f, 0x51, 0x53, 0x5c, 0x3a, 0x35, 0xe2}},
+};
+
+// Piece sizes cycled through while feeding the data, 0 included, 63 and 65 straddle block boundaries.
+static const size_t wholeMessage[] = {1000};
+static const size_t byteByByte[] = {1};
+static const size_t uneven[] = {3, 0, 7, 1, 63, 2, 65, 13};
+
+static void mac(const HmacCase& c, const size_t* pieces, size_t numPieces, uint8_t* out) {
+    uint8_t key[131];
+    if (c.key) {
+        memcpy(key, c.key, c.keyLen);
+    } else {
+        memset(key, c.keyByte, c.keyLen);
+    }
+    HmacSha256 hmac;
+    hmac.begin(key, c.keyLen);
+    const uint8_t* data = (const uint8_t*)c.data;
+    size_t left = strlen(c.data);
+    for (size_t p = 0; left > 0; p++) {
+        size_t n = pieces[p % numPieces];
+        if (n > left) n = left;
+        hmac.update(data, n);
+        data += n;
+        left -= n;
+    }
+    hmac.finish(out);
+}
+
+static void check(const size_t* pieces, size_t numPieces) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint8_t out[SHA256_DIGEST_SIZE];
+        mac(cases[i], pieces, numPieces, out);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(cases[i].mac, out, SHA256_DIGEST_SIZE);
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_hmac_whole(void) {
+    check(wholeMessage, 1);
+}
+
+void test_hmac_byte_by_byte(void) {
+    check(byteByByte, 1);
+}
+
+void test_hmac_uneven(void) {
+    check(uneven, sizeof(uneven) / sizeof(uneven[0]));
+}
+
+// A finished object starts over with the next begin.
+void test_hmac_reuse(void) {
+    uint8_t out[SHA256_DIGEST_SIZE];
+    HmacSha256 hmac;
+    hmac.begin((const uint8_t*)"other", 5);
+    hmac.update((const uint8_t*)cases[3].data, 100);
+    hmac.finish(out);
+    hmac.begin((const uint8_t*)cases[1].key, cases[1].keyLen);
+    hmac.update((const uint8_t*)cases[1].data, strlen(cases[1].data));
+    hmac.finish(out);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(cases[1].mac, out, SHA256_DIGEST_SIZE);
+}
+
+// As tools/ingestserver.py signs a reply: over the request's X-Signature, then the JSON.
+void test_reply_signature(void) {
+    uint8_t key[64];
+    for (int i = 0; i < 64; i++) key[i] = i;
+    char signature[2 * SHA256_DIGEST_SIZE + 1];
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) memcpy(&signature[2 * i], "ab", 2);
+    signature[2 * SHA256_DIGEST_SIZE] = 0x00;
+    const char* reply = "{\"status\": \"ok\", \"ack\": 41}";
+    const char* replySignature = "8a9e46e2fe3d18e9376105f9eb3fe5e4ced03a69d715eaa033f13054413d5fe1";
+    TEST_ASSERT_TRUE(Uploader::checkReply(reply, strlen(reply), signature, replySignature, key, sizeof(key)));
+    const char* upperCase = "8A9E46E2FE3D18E9376105F9EB3FE5E4CED03A69D715EAA033F13054413D5FE1";
+    TEST_ASSERT_TRUE(Uploader::checkReply(reply, strlen(reply), signature, upperCase, key, sizeof(key)));
+    const char* other = "{\"status\": \"ok\", \"ack\": 42}";
+    TEST_ASSERT_FALSE(Uploader::checkReply(other, strlen(other), signature, replySignature, key, sizeof(key)));
+    signature[0] = 'c';  // Reply to another request
+    TEST_ASSERT_FALSE(Uploader::checkReply(reply, strlen(reply), signature, replySignature, key, sizeof(key)));
+    signature[0] = 'a';
+    TEST_ASSERT_FALSE(Uploader::checkReply(reply, strlen(reply), signature, "", key, sizeof(key)));
+    TEST_ASSERT_FALSE(Uploader::checkReply(reply, strlen(reply), signature, NULL, key, sizeof(key)));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_hmac_whole);
+    RUN_TEST(test_hmac_byte_by_byte);
+    RUN_TEST(test_hmac_uneven);
+    RUN_TEST(test_hmac_reuse);
+    RUN_TEST(test_reply_signature);
+    return UNITY_END();
+}
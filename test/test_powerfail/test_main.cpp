@@ -0,0 +1,112 @@
+// RTCC power-fail timestamps and the TYPE_PWRFAIL record setup() appends for them.
+#include <Adafruit_MCP23017.h>
+#include <Arduino.h>
+#include <hostsim.h>
+#include <simeeprom.h>
+#include <simrtcc.h>
+#include <unity.h>
+
+#include "eepromstore.h"
+#include "measurementlog.h"
+#include "pinout.h"
+#include "rtcc.h"
+
+Adafruit_MCP23017 ioexpander;
+
+static SimEEPROM eeprom0;
+static SimRTCC* rtcc = NULL;
+
+// Unix time of a UTC date, the timestamps only hold whole minutes.
+static time_t utc(int year, int mon, int mday, int hour, int min) {
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = mon - 1;
+    t.tm_mday = mday;
+    t.tm_hour = hour;
+    t.tm_min = min;
+    return mktime(&t);
+}
+
+// Boots the clock with a fresh RTCC, as setup() does.
+static void boot(time_t now, time_t down, time_t up) {
+    delete rtcc;
+    rtcc = new SimRTCC();
+    simAttachI2CDevice(rtcc, SIMRTCC_ADDRESS);
+    rtcc->start(now);
+    if (down) rtcc->powerFail(down, up);
+    memset((uint8_t*)&Clock.store, 0, sizeof(RTCCmem));
+    Clock.running = false;
+    Clock.powerfail = 0;
+    Clock.powerreturn = 0;
+    Clock.begin();
+    eepromStore.setClock(0);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_no_powerfail(void) {
+    boot(utc(2021, 6, 15, 12, 0), 0, 0);
+    TEST_ASSERT_TRUE(Clock.running);
+    TEST_ASSERT_EQUAL(0, Clock.powerfail);
+}
+
+void test_powerfail_timestamps(void) {
+    time_t down = utc(2021, 6, 15, 11, 30);
+    time_t up = utc(2021, 6, 15, 11, 45);
+    boot(utc(2021, 6, 15, 12, 0), down, up);
+    TEST_ASSERT_EQUAL(down, Clock.powerfail);
+    TEST_ASSERT_EQUAL(up, Clock.powerreturn);
+    TEST_ASSERT_EQUAL(0, rtcc->regs[0x03] & 0x10);  // PWRFAIL cleared
+    TEST_ASSERT_TRUE(rtcc->regs[0x03] & 0x20);      // Oscillator still running
+}
+
+// The timestamps have no year, one from a later month than now is from the year before.
+void test_powerfail_year_rollover(void) {
+    time_t down = utc(2020, 12, 31, 23, 50);
+    time_t up = utc(2021, 1, 1, 0, 5);
+    boot(utc(2021, 1, 1, 0, 10), down, up);
+    TEST_ASSERT_EQUAL(down, Clock.powerfail);
+    TEST_ASSERT_EQUAL(up, Clock.powerreturn);
+
+    down = utc(2020, 12, 31, 23, 50);
+    up = utc(2020, 12, 31, 23, 58);
+    boot(utc(2021, 1, 1, 0, 10), down, up);
+    TEST_ASSERT_EQUAL(down, Clock.powerfail);
+    TEST_ASSERT_EQUAL(up, Clock.powerreturn);
+}
+
+void test_powerfail_record(void) {
+    time_t now = utc(2021, 1, 1, 0, 10);
+    time_t down = utc(2020, 12, 31, 23, 50);
+    time_t up = utc(2021, 1, 1, 0, 5);
+    boot(now, down, up);
+    uint32_t seq = Clock.store.nextId;
+    TEST_ASSERT_TRUE(measurementLog.appendPowerFail(Clock.getTime(), Clock.powerfail, Clock.powerreturn));
+    TEST_ASSERT_EQUAL(seq + 1, Clock.store.nextId);
+
+    Measurement m;
+    TEST_ASSERT_TRUE(measurementLog.read(m, seq));
+    TEST_ASSERT_EQUAL(Measurement::TYPE_PWRFAIL, m.type);
+    TEST_ASSERT_EQUAL(now, m.timestamp);
+    TEST_ASSERT_EQUAL(down, m.powerfail);
+    TEST_ASSERT_EQUAL(up, m.powerback);
+}
+
+int main(int argc, char** argv) {
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    simAttachSpiDevice(&eeprom0, IOEXP_EEPROM0);
+    ioexpander.begin();
+    ioexpander.digitalWrite(IOEXP_EEPROM0, HIGH);
+    ioexpander.pinMode(IOEXP_EEPROM0, OUTPUT);
+    eepromStore.updateMaxPages(EEPROM_PAGESPERCHIP);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_no_powerfail);
+    RUN_TEST(test_powerfail_timestamps);
+    RUN_TEST(test_powerfail_year_rollover);
+    RUN_TEST(test_powerfail_record);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""Pulls the measurement log from a device over serial and writes it as CSV.
+
+Uses the shell's binary export command ('e', see include/logexport.h). The device must have its shell open.
+
+    exportlog.py --port /dev/ttyUSB0 > log.csv
+    exportlog.py --input capture.bin > log.csv     # Decode a raw capture of the export stream
+
+The serial mode needs pyserial.
+"""
+import argparse
+import csv
+import math
+import struct
+import sys
+import zlib
+
+CONSOLE_BAUD = 115200  # EXPORT_CONSOLE_BAUD
+MAGIC = b"\xa5\x5a"  # EXPORT_MAGIC0, EXPORT_MAGIC1
+END_PAGE = 0xFFFFFFFF  # EXPORT_END_PAGE
+PAGE_SIZE = 64
+FRAME_SIZE = 2 + 4 + PAGE_SIZE + 4
+
+# Measurement layout, include/measurement.h. CHANNELS are the keys of Measurement::channels, in order.
+RECORD = struct.Struct("<HBBI13fI")
+CHANNELS = ["bat", "press", "btemp", "hum", "htemp", "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7"]
+TYPES = {0x01: "sample", 0x02: "min", 0x03: "max", 0x04: "mean", 0x20: "pwrfail", 0x21: "health"}
+TYPE_PWRFAIL = 0x20
+TYPE_HEALTH = 0x21
+# Health records keep bat and overlay these counters on the channels after it, Measurement::healthFields.
+HEALTH = struct.Struct("<IIiIIIIIIIII")
+HEALTH_KEYS = ["heap", "maxblock", "rssi", "chan", "connms", "tlsms", "eewrites", "eeretries", "wakems", "reset", "sensto", "sensms"]
+
+
+def frames(data):
+    """Yields (page, payload) for every intact frame, resyncing on the magic after damage."""
+    pos = 0
+    while True:
+        pos = data.find(MAGIC, pos)
+        if pos < 0 or pos + FRAME_SIZE > len(data):
+            return
+        frame = data[pos:pos + FRAME_SIZE]
+        (page,) = struct.unpack_from("<I", frame, 2)
+        (crc,) = struct.unpack_from("<I", frame, 2 + 4 + PAGE_SIZE)
+        if zlib.crc32(frame[2:2 + 4 + PAGE_SIZE]) != crc:
+            pos += 1
+            continue
+        yield page, frame[6:6 + PAGE_SIZE]
+        if page == END_PAGE:
+            return
+        pos += FRAME_SIZE
+
+
+def decode(data, out):
+    writer = csv.writer(out)
+    writer.writerow(["page", "id", "type", "bits", "ts"] + CHANNELS + ["pwrfail", "pwrback"] + HEALTH_KEYS)
+    good = bad = 0
+    expected = None
+    for page, payload in frames(data):
+        if page == END_PAGE:
+            (expected,) = struct.unpack_from("<I", payload)
+            break
+        fields = RECORD.unpack(payload)
+        if zlib.crc32(payload[:-4]) != fields[-1] or fields[1] not in TYPES:
+            bad += 1  # Never written, overwritten mid-way or not a measurement page
+            continue
+        good += 1
+        rid, rtype, bits, ts = fields[:4]
+        values = list(fields[4:17])
+        pwr = ["", ""]
+        health = [""] * len(HEALTH_KEYS)
+        if rtype == TYPE_PWRFAIL:
+            pwr = struct.unpack_from("<II", payload, 8)
+            values = [float("nan")] * len(CHANNELS)
+        elif rtype == TYPE_HEALTH:
+            health = HEALTH.unpack_from(payload, 12)
+            values = values[:1] + [float("nan")] * (len(CHANNELS) - 1)
+        cells = ["" if math.isnan(v) else "%.2f" % v for v in values]
+        writer.writerow([page, rid, TYPES[rtype], bits, ts] + cells + list(pwr) + list(health))
+    received = good + bad
+    print("%d records, %d other pages, %s pages announced" % (good, bad, expected), file=sys.stderr)
+    if expected is None or expected != received:
+        print("Export incomplete, %d of %s pages received" % (received, expected), file=sys.stderr)
+        return 1
+    return 0
+
+
+def capture(port, first, count, timeout):
+    import serial
+
+    with serial.Serial(port, CONSOLE_BAUD, timeout=timeout) as dev:
+        dev.reset_input_buffer()
+        command = "e" if first is None else "e%d %d" % (first, count)
+        dev.write((command + "\n").encode())
+        while True:
+            line = dev.readline()
+            if not line:
+                sys.exit("No answer to export command, is the shell open?")
+            if line.startswith(b"EXPORT"):
+                break
+        _, first, count, baud = line.decode().split()
+        dev.flush()
+        dev.baudrate = int(baud)
+        data = bytearray()
+        end = MAGIC + struct.pack("<I", END_PAGE)
+        while end not in data[-2 * FRAME_SIZE:]:
+            chunk = dev.read(4096)
+            if not chunk:
+                break
+            data += chunk
+        tail = data.rfind(end)
+        if tail >= 0 and len(data) < tail + FRAME_SIZE:
+            data += dev.read(tail + FRAME_SIZE - len(data))
+        dev.baudrate = CONSOLE_BAUD
+        return bytes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="Serial port of the device")
+    source.add_argument("--input", help="Raw export capture, - for stdin")
+    parser.add_argument("--first", type=int, help="First page, defaults to the first measurement page")
+    parser.add_argument("--count", type=int, default=0, help="Number of pages, 0 for all")
+    parser.add_argument("--raw", help="Also save the raw export stream here")
+    parser.add_argument("--timeout", type=float, default=5.0)
+    args = parser.parse_args()
+
+    if args.port:
+        data = capture(args.port, args.first, args.count, args.timeout)
+    elif args.input == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    if args.raw:
+        with open(args.raw, "wb") as f:
+            f.write(data)
+    sys.exit(decode(data, sys.stdout))
+
+
+if __name__ == "__main__":
+    main()
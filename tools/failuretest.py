@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Checks exactly-once delivery under injected upload failures.
+
+Starts ingestserver.py with --drop, --lose-reply and --partial each at --rate, runs the fleet simulator
+against it and then checks the records the server stored:
+    - every device's sequence numbers are stored once each, in order, without gaps
+    - the server holds every record the devices saw acknowledged, and none they did not store; it may hold a
+      few more than were acknowledged, from replies lost at the end of the run
+    - the server counted no missing records
+Records sent again after a lost reply or a partial store must only show up in the server's "sent again" count.
+
+    pio run -e fleet
+    tools/failuretest.py --devices 20 --days 2
+
+Exits 0 if all checks pass.
+"""
+import argparse
+import json
+import os
+import re
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+
+
+def wait_for_port(port, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection(("127.0.0.1", port), 0.2).close()
+            return True
+        except OSError:
+            time.sleep(0.1)
+    return False
+
+
+def check_store(store):
+    """Returns the number of records stored and a list of problems found."""
+    total = 0
+    problems = []
+    for name in sorted(os.listdir(store)):
+        if not name.endswith(".jsonl"):
+            continue
+        with open(os.path.join(store, name)) as f:
+            seqs = [json.loads(line)["seq"] for line in f]
+        total += len(seqs)
+        if len(set(seqs)) != len(seqs):
+            problems.append("%s: %d records stored twice" % (name, len(seqs) - len(set(seqs))))
+        if seqs and seqs != list(range(seqs[0], seqs[0] + len(seqs))):
+            problems.append("%s: sequence numbers out of order or with gaps" % name)
+        if seqs and seqs[0] != 0:
+            problems.append("%s: first record %d, expected 0" % (name, seqs[0]))
+    return total, problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--fleet", default=".pio/build/fleet/program", help="Fleet simulator binary")
+    parser.add_argument("--port", type=int, default=8089)
+    parser.add_argument("--rate", type=float, default=0.2, help="Probability of each failure type per request")
+    parser.add_argument("--devices", type=int, default=20)
+    parser.add_argument("--days", type=int, default=2)
+    parser.add_argument("--speedup", type=int, default=86400)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    store = tempfile.mkdtemp(prefix="failuretest")
+    rate = str(args.rate)
+    server = subprocess.Popen([sys.executable, os.path.join(TOOLS, "ingestserver.py"), "--port", str(args.port),
+                               "--store", store, "--secret", "fleet", "--seed", str(args.seed), "--drop", rate,
+                               "--lose-reply", rate, "--partial", rate],
+                              stderr=subprocess.PIPE, text=True)
+    try:
+        if not wait_for_port(args.port, 10):
+            print("Ingest server did not start", file=sys.stderr)
+            return 1
+        fleet = subprocess.run([args.fleet, "--port", str(args.port), "--devices", str(args.devices), "--days",
+                                str(args.days), "--speedup", str(args.speedup), "--secret", "fleet", "--seed",
+                                str(args.seed)], stdout=subprocess.PIPE, text=True)
+    finally:
+        server.send_signal(signal.SIGINT)
+        report = server.communicate(timeout=30)[1]
+    print(fleet.stdout, end="")
+    print(report, end="", file=sys.stderr)
+
+    problems = []
+    if fleet.returncode != 0:
+        problems.append("fleet exited with %d" % fleet.returncode)
+    match = re.search(r"Records:\s+(\d+) stored, (\d+) acknowledged", fleet.stdout)
+    logged = int(match.group(1)) if match else None
+    acked = int(match.group(2)) if match else None
+    stored, found = check_store(store)
+    problems += found
+    if acked is None:
+        problems.append("no record count from the fleet")
+    elif not acked <= stored <= logged:
+        problems.append("server stored %d records, devices stored %d and saw %d acknowledged" % (stored, logged, acked))
+    missing = sum(int(m) for m in re.findall(r"(\d+) missing", report))
+    if missing:
+        problems.append("server counted %d missing records" % missing)
+    resent = sum(int(m) for m in re.findall(r"(\d+) sent again", report))
+
+    print("%d records stored once each, %d sent again" % (stored, resent))
+    for problem in problems:
+        print("FAIL: " + problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+"""Local stand-in for the upload endpoint, with failure injection.
+
+Implements the acknowledgement protocol described above Uploader::run: records are kept
+per device serial, the reply carries the highest stored sequence number as "ack", and records at or below it
+are ignored when a batch is sent again. Stored records are appended to <store>/<serial>.jsonl.
+
+    ingestserver.py --port 8080 --drop 0.1 --lose-reply 0.1 --partial 0.1
+
+Failures, each drawn per request:
+    --drop        close the connection without storing or answering (TLS failure, timeout)
+    --lose-reply  store the batch but close the connection before answering (power loss mid-upload)
+    --partial     store only part of the batch and answer with a failed status and the partial ack
+At exit it prints per device how many records were stored, sent more than once or missing.
+
+--config serves a remote config, a JSON file like {"version": 2, "config": {"si": 300, "sd": [10, 50, 10, 5]}}.
+Devices reporting another "cfgver" get it with their next successful upload reply.
+
+--tokens checks upload signatures, a JSON file mapping serial to the base64 device token handed out at
+registration. Batches from listed devices without a valid X-Signature (HMAC-SHA256 of the body) are refused.
+Replies to devices with a token carry an X-Signature too, HMAC-SHA256 over the request's X-Signature and the
+JSON, devices on plain http take no ack or config without it.
+
+api/register.php hands out device tokens to devices presenting the registration secret (--secret, any if not
+given). Issued tokens are added to <store>/tokens.json, in the --tokens format, and checked from then on.
+
+At exit it also prints the load seen: requests per second, bytes received and handling time percentiles.
+Run the fleet simulator (the fleet env) against it for load tests.
+"""
+import argparse
+import base64
+import hashlib
+import hmac
+import json
+import os
+import random
+import ssl
+import sys
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Device:
+    def __init__(self, path):
+        self.path = path
+        self.ack = None  # Highest stored sequence number
+        self.stored = 0
+        self.duplicates = 0
+        self.missing = 0
+        if os.path.exists(path):
+            with open(path) as f:
+                for line in f:
+                    self.ack = json.loads(line)["seq"]
+                    self.stored += 1
+
+    def store(self, first, last, records):
+        """Stores records newer than the ack, returns the new ack."""
+        with open(self.path, "a") as f:
+            for record in records:
+                seq = first + ((record["id"] - first) & 0xFFFF)  # id holds the low 16 bits of the sequence number
+                if self.ack is not None and seq <= self.ack:
+                    self.duplicates += 1
+                    continue
+                if self.ack is not None and seq > self.ack + 1:
+                    self.missing += seq - self.ack - 1
+                record["seq"] = seq
+                f.write(json.dumps(record) + "\n")
+                self.ack = seq
+                self.stored += 1
+            f.flush()
+            os.fsync(f.fileno())
+        # Records the device could not read are skipped, the whole range is done.
+        if self.ack is None or last > self.ack:
+            self.ack = last
+        return self.ack
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if self.server.args.verbose:
+            super().log_message(fmt, *args)
+
+    def do_POST(self):
+        start = time.monotonic()
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        self.reply_key = None
+        if self.path.endswith("register.php"):
+            self.register(body)
+        elif self.path.endswith("upload.php"):
+            self.upload(body)
+        else:
+            self.reply({"status": "error", "message": "unknown service"})
+        self.server.account(len(body), time.monotonic() - start)
+
+    def register(self, body):
+        try:
+            query = json.loads(body)
+            serial = int(query["serial"])
+            secret = query["token"]
+        except (ValueError, KeyError, TypeError):
+            self.reply({"status": "error", "message": "bad request"})
+            return
+        if self.server.args.secret is not None and secret != self.server.args.secret:
+            self.reply({"status": "denied"})
+            return
+        # 60 random bytes and their CRC32, the device checks it like every other CRC'd page.
+        token = os.urandom(60)
+        token += zlib.crc32(token).to_bytes(4, "little")
+        self.server.issue(serial, token)
+        self.reply({"status": "registered", "token": base64.b64encode(token).decode()})
+
+    def upload(self, body):
+        try:
+            query = json.loads(body)
+            serial = int(query["serial"])
+            first, last = int(query["first"]), int(query["last"])
+            records = query["measurements"]
+        except (ValueError, KeyError, TypeError):
+            self.reply({"status": "error", "message": "bad request"})
+            return
+
+        token = self.server.tokens.get(str(serial))
+        self.reply_key = token
+        if token is not None:
+            expected = hmac.new(token, body, hashlib.sha256).hexdigest()
+            if not hmac.compare_digest(expected, self.headers.get("X-Signature", "")):
+                self.reply({"status": "error", "message": "bad signature"})
+                return
+
+        args = self.server.args
+        device = self.server.device(serial)
+        if random.random() < args.drop:
+            self.close_connection = True
+            return
+        if random.random() < args.partial and len(records) > 1:
+            ack = device.store(first, first + len(records) // 2 - 1, records[: len(records) // 2])
+            self.reply({"status": "error", "message": "partial", "ack": ack})
+            return
+        ack = device.store(first, last, records)
+        if random.random() < args.lose_reply:
+            self.close_connection = True
+            return
+        answer = {"status": "ok", "ack": ack}
+        config = self.server.config
+        if config and query.get("cfgver") != config["version"]:
+            answer["cfgver"] = config["version"]
+            answer["config"] = config["config"]
+        self.reply(answer)
+
+    def reply(self, obj):
+        # The device skips the chunk size line and reads the JSON from the next one.
+        payload = json.dumps(obj).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        if self.reply_key is not None:
+            signed = self.headers.get("X-Signature", "").encode() + payload
+            self.send_header("X-Signature", hmac.new(self.reply_key, signed, hashlib.sha256).hexdigest())
+        self.send_header("Transfer-Encoding", "chunked")
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.wfile.write(b"%x\r\n%s\r\n0\r\n\r\n" % (len(payload), payload))
+        self.close_connection = True
+
+
+class IngestServer(ThreadingHTTPServer):
+    request_queue_size = 256  # A fleet connects in bursts
+    daemon_threads = True
+
+    def __init__(self, address, args):
+        super().__init__(address, Handler)
+        self.args = args
+        self.devices = {}
+        self.config = None
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.bytes = 0
+        self.times = []
+        self.started = None
+        self.tokens_path = os.path.join(args.store, "tokens.json")
+        os.makedirs(args.store, exist_ok=True)
+        self.issued = {}
+        if os.path.exists(self.tokens_path):
+            with open(self.tokens_path) as f:
+                self.issued = json.load(f)
+        self.tokens = {serial: base64.b64decode(token) for serial, token in self.issued.items()}
+        if args.tokens:
+            with open(args.tokens) as f:
+                self.tokens.update({serial: base64.b64decode(token) for serial, token in json.load(f).items()})
+        if args.config:
+            with open(args.config) as f:
+                self.config = json.load(f)
+
+    def device(self, serial):
+        with self.lock:
+            if serial not in self.devices:
+                self.devices[serial] = Device(os.path.join(self.args.store, "%d.jsonl" % serial))
+            return self.devices[serial]
+
+    def issue(self, serial, token):
+        with self.lock:
+            self.tokens[str(serial)] = token
+            self.issued[str(serial)] = base64.b64encode(token).decode()
+            with open(self.tokens_path + ".tmp", "w") as f:
+                json.dump(self.issued, f)
+            os.replace(self.tokens_path + ".tmp", self.tokens_path)  # Readers never see a partial file
+
+    def account(self, size, seconds):
+        with self.lock:
+            now = time.monotonic()
+            if self.started is None:
+                self.started = now - seconds
+            self.last = now
+            self.requests += 1
+            self.bytes += size
+            self.times.append(seconds)
+
+    def print_load(self):
+        if not self.requests:
+            return
+        elapsed = max(self.last - self.started, 1e-6)
+        times = sorted(self.times)
+
+        def percentile(p):
+            return times[min(len(times) - 1, int(p * len(times)))] * 1000
+
+        print("%d requests in %.1f s, %.1f/s, %d bytes received (%.0f/s)" %
+              (self.requests, elapsed, self.requests / elapsed, self.bytes, self.bytes / elapsed), file=sys.stderr)
+        print("Handling ms: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f" %
+              (percentile(0.5), percentile(0.95), percentile(0.99), times[-1] * 1000), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--store", default="ingest", help="Directory for the stored records")
+    parser.add_argument("--drop", type=float, default=0.0)
+    parser.add_argument("--lose-reply", type=float, default=0.0)
+    parser.add_argument("--partial", type=float, default=0.0)
+    parser.add_argument("--seed", type=int)
+    parser.add_argument("--config", help="Remote config to hand out")
+    parser.add_argument("--tokens", help="Device tokens for checking signatures")
+    parser.add_argument("--secret", help="Registration secret, any is accepted if not given")
+    parser.add_argument("--certfile", help="Serve HTTPS with this certificate")
+    parser.add_argument("--keyfile")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    server = IngestServer(("", args.port), args)
+    if args.certfile:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.certfile, args.keyfile)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    for serial, device in sorted(server.devices.items()):
+        print("%d: %d stored, %d sent again, %d missing, ack %s" %
+              (serial, device.stored, device.duplicates, device.missing, device.ack), file=sys.stderr)
+    server.print_load()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""Reference collector for datagram uploads (udp:// URLs), for trusted LANs and testing.
+
+Receives the binary batches described in include/uploader.h: a 20 byte header, the records as stored in
+EEPROM (64 bytes each with their CRC) and for signed batches a 32 byte HMAC-SHA256. Every batch is answered
+with a 24 byte ack carrying the highest stored sequence number, so the device resends only what is missing.
+Records are stored like tools/ingestserver.py does, in <store>/<serial>.jsonl with the same fields.
+
+    udpcollector.py --port 5684 --store ingest --tokens ingest/tokens.json --drop 0.1 --lose-ack 0.1
+
+--tokens is a JSON file mapping serial to base64 device token, as written by ingestserver.py. It is read
+again when a signed batch arrives from a serial it does not know. Signed batches from unknown devices and
+batches with a bad signature are dropped, listed devices must sign.
+"""
+import argparse
+import base64
+import hashlib
+import hmac
+import json
+import math
+import os
+import random
+import socket
+import struct
+import sys
+import time
+import zlib
+
+from exportlog import CHANNELS, HEALTH, HEALTH_KEYS, RECORD, TYPE_HEALTH, TYPE_PWRFAIL
+from ingestserver import Device
+
+BATCH_MAGIC = 0x5354  # UPLOAD_BATCH_MAGIC
+ACK_MAGIC = 0x4154  # UPLOAD_ACK_MAGIC
+VERSION = 1
+FLAG_SIGNED = 0x01
+ACK_OK, ACK_FAILED = 0, 1
+HEADER = struct.Struct("<HBBIIII")  # UploadBatchHeader
+ACK = struct.Struct("<HBBIII")  # UploadAck without its MAC
+ACK_MAC_SIZE = 8
+MAC_SIZE = 32
+RECORD_SIZE = 64
+
+
+def record_dict(payload):
+    """The record as the JSON upload would carry it, None if its CRC fails."""
+    fields = RECORD.unpack(payload)
+    if zlib.crc32(payload[:-4]) != fields[-1]:
+        return None
+    rid, rtype, bits, ts = fields[:4]
+    record = {"id": rid, "type": rtype, "bits": bits, "ts": ts}
+    if rtype == TYPE_PWRFAIL:
+        record["pwrfail"], record["pwrback"] = struct.unpack_from("<II", payload, 8)
+        return record
+    if rtype == TYPE_HEALTH:
+        if math.isfinite(fields[4]):
+            record["bat"] = round(fields[4], 4)
+        record.update(zip(HEALTH_KEYS, HEALTH.unpack_from(payload, 12)))
+        return record
+    for name, value in zip(CHANNELS, fields[4:17]):
+        if math.isfinite(value):
+            record[name] = round(value, 4)
+    return record
+
+
+class Collector:
+    def __init__(self, args):
+        self.args = args
+        self.devices = {}
+        self.tokens = {}
+        self.tokens_mtime = None
+        self.datagrams = 0
+        self.bytes = 0
+        self.rejected = 0
+        self.started = None
+        os.makedirs(args.store, exist_ok=True)
+        self.load_tokens()
+
+    def load_tokens(self):
+        if not self.args.tokens or not os.path.exists(self.args.tokens):
+            return
+        mtime = os.path.getmtime(self.args.tokens)
+        if mtime == self.tokens_mtime:
+            return
+        with open(self.args.tokens) as f:
+            self.tokens = {int(serial): base64.b64decode(token) for serial, token in json.load(f).items()}
+        self.tokens_mtime = mtime
+
+    def device(self, serial):
+        if serial not in self.devices:
+            self.devices[serial] = Device(os.path.join(self.args.store, "%d.jsonl" % serial))
+        return self.devices[serial]
+
+    def handle(self, data):
+        """Returns the ack datagram for a batch, None to stay silent."""
+        if len(data) < HEADER.size:
+            return None
+        magic, version, flags, serial, first, last, cfgver = HEADER.unpack_from(data)
+        if magic != BATCH_MAGIC or version != VERSION:
+            return None
+        key = None
+        if flags & FLAG_SIGNED:
+            if serial not in self.tokens:
+                self.load_tokens()
+            key = self.tokens.get(serial)
+            body, mac = data[:-MAC_SIZE], data[-MAC_SIZE:]
+            if key is None or not hmac.compare_digest(hmac.new(key, body, hashlib.sha256).digest(), mac):
+                self.rejected += 1
+                return None
+        elif serial in self.tokens:
+            self.rejected += 1
+            return None
+        else:
+            body = data
+        payload = body[HEADER.size:]
+        if len(payload) % RECORD_SIZE:
+            self.rejected += 1
+            return None
+
+        records = []
+        for offset in range(0, len(payload), RECORD_SIZE):
+            record = record_dict(payload[offset:offset + RECORD_SIZE])
+            if record is not None:
+                records.append(record)
+        device = self.device(serial)
+        if random.random() < self.args.drop:
+            return None
+        ack = device.store(first, last, records)
+        if random.random() < self.args.lose_ack:
+            return None
+        status = ACK_OK if ack >= last else ACK_FAILED
+        answer = ACK.pack(ACK_MAGIC, VERSION, status, serial, first, ack)
+        mac = hmac.new(key, answer, hashlib.sha256).digest()[:ACK_MAC_SIZE] if key else bytes(ACK_MAC_SIZE)
+        return answer + mac
+
+    def serve(self):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+        sock.bind(("", self.args.port))
+        while True:
+            data, address = sock.recvfrom(2048)
+            if self.started is None:
+                self.started = time.monotonic()
+            self.last = time.monotonic()
+            self.datagrams += 1
+            self.bytes += len(data)
+            answer = self.handle(data)
+            if answer:
+                sock.sendto(answer, address)
+
+    def report(self):
+        for serial, device in sorted(self.devices.items()):
+            print("%d: %d stored, %d sent again, %d missing, ack %s" %
+                  (serial, device.stored, device.duplicates, device.missing, device.ack), file=sys.stderr)
+        if self.datagrams:
+            elapsed = max(self.last - self.started, 1e-6)
+            print("%d datagrams in %.1f s, %.1f/s, %d bytes received, %d rejected" %
+                  (self.datagrams, elapsed, self.datagrams / elapsed, self.bytes, self.rejected), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=5684)
+    parser.add_argument("--store", default="ingest", help="Directory for the stored records")
+    parser.add_argument("--tokens", help="Device tokens for checking signatures")
+    parser.add_argument("--drop", type=float, default=0.0, help="Ignore this share of batches")
+    parser.add_argument("--lose-ack", type=float, default=0.0, help="Store but do not answer this share")
+    parser.add_argument("--seed", type=int)
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    collector = Collector(args)
+    try:
+        collector.serve()
+    except KeyboardInterrupt:
+        pass
+    collector.report()
+
+
+if __name__ == "__main__":
+    main()